@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <cmath>
+
+#include "corpus_generator.h"
+
+namespace {
+    // Base-26 spelling of the rank, so words look like words and never collide
+    std::string SpellWord(size_t rank, char first_letter) {
+        std::string word(1, first_letter);
+
+        do {
+            word.push_back(static_cast <char> ('a' + rank % 26));
+            rank /= 26;
+        } while (rank > 0);
+
+        return word;
+    }
+}
+
+CorpusGenerator::CorpusGenerator(const CorpusOptions& options)
+    : options_(options)
+    , generator_(options.seed)
+{
+    vocabulary_.reserve(options_.vocabulary_size);
+    zipf_cdf_.reserve(options_.vocabulary_size);
+
+    double total_weight = 0.0;
+
+    for (size_t rank = 0; rank < std::max <size_t> (options_.vocabulary_size, 1); ++rank) {
+        vocabulary_.push_back(SpellWord(rank, 'w'));
+        total_weight += 1.0 / std::pow(rank + 1.0, options_.zipf_exponent);
+        zipf_cdf_.push_back(total_weight);
+    }
+
+    for (double& weight : zipf_cdf_) {
+        weight /= total_weight;
+    }
+
+    for (size_t index = 0; index < options_.stop_word_count; ++index) {
+        stop_words_.push_back(SpellWord(index, 's'));
+    }
+}
+
+std::string CorpusGenerator::GetStopWords() const {
+    std::string stop_words;
+
+    for (const std::string& word : stop_words_) {
+        stop_words += word + ' ';
+    }
+
+    return stop_words;
+}
+
+std::vector <DocumentRecord> CorpusGenerator::GenerateDocuments() {
+    std::vector <DocumentRecord> documents;
+    documents.reserve(options_.document_count);
+
+    for (size_t index = 0; index < options_.document_count; ++index) {
+        DocumentRecord record;
+        record.id = static_cast <int> (index);
+
+        const size_t status_roll = NextIndex(100);
+        record.status = status_roll < 85 ? DocumentStatus::ACTUAL : status_roll < 92 ? DocumentStatus::IRRELEVANT : status_roll < 97 ? DocumentStatus::BANNED : DocumentStatus::REMOVED;
+
+        for (size_t rating_count = NextInRange(1, 5); rating_count > 0; --rating_count) {
+            record.ratings.push_back(static_cast <int> (NextInRange(0, 20)) - 10);
+        }
+
+        const std::string* original = !documents.empty() && NextUnit() < options_.duplicate_rate ? &documents[NextIndex(documents.size())].text : nullptr;
+
+        if (original != nullptr && !original->empty()) {
+            // same words in another order and count, so only the word set repeats
+            std::vector <std::string> words;
+
+            for (size_t begin = 0, end; begin < original->size(); begin = end + 1) {
+                end = std::min(original->find(' ', begin), original->size());
+                words.emplace_back(original->substr(begin, end - begin));
+            }
+
+            words.push_back(words[NextIndex(words.size())]);
+
+            // Fisher-Yates by hand: std::shuffle is free to differ between standard libraries
+            for (size_t position = words.size() - 1; position > 0; --position) {
+                std::swap(words[position], words[NextIndex(position + 1)]);
+            }
+
+            for (const std::string& word : words) {
+                record.text += record.text.empty() ? word : ' ' + word;
+            }
+        } else {
+            for (size_t length = NextInRange(options_.min_document_length, options_.max_document_length); length > 0; --length) {
+                const std::string& word = !stop_words_.empty() && NextUnit() < options_.stop_word_ratio ? stop_words_[NextIndex(stop_words_.size())] : NextWord();
+                record.text += record.text.empty() ? word : ' ' + word;
+            }
+        }
+
+        documents.push_back(std::move(record));
+    }
+
+    return documents;
+}
+
+std::vector <std::string> CorpusGenerator::GenerateQueries() {
+    std::vector <std::string> queries;
+    queries.reserve(options_.query_count);
+
+    for (size_t index = 0; index < options_.query_count; ++index) {
+        std::string query;
+
+        for (size_t length = NextInRange(options_.min_query_length, options_.max_query_length); length > 0; --length) {
+            if (!query.empty()) {
+                query.push_back(' ');
+            }
+
+            if (!stop_words_.empty() && NextUnit() < options_.stop_word_ratio) {
+                query += stop_words_[NextIndex(stop_words_.size())];
+            } else {
+                // separate statements: the order of the two draws must not be left to the compiler
+                if (NextUnit() < options_.minus_word_rate) {
+                    query.push_back('-');
+                }
+
+                query += NextWord();
+            }
+        }
+
+        queries.push_back(std::move(query));
+    }
+
+    return queries;
+}
+
+double CorpusGenerator::NextUnit() {
+    return (generator_() >> 11) * 0x1.0p-53;
+}
+
+size_t CorpusGenerator::NextIndex(size_t count) {
+    return std::min(static_cast <size_t> (NextUnit() * count), count - 1);
+}
+
+size_t CorpusGenerator::NextInRange(size_t min_value, size_t max_value) {
+    return max_value <= min_value ? min_value : min_value + NextIndex(max_value - min_value + 1);
+}
+
+const std::string& CorpusGenerator::NextWord() {
+    const size_t rank = std::lower_bound(zipf_cdf_.begin(), zipf_cdf_.end(), NextUnit()) - zipf_cdf_.begin();
+    return vocabulary_[std::min(rank, vocabulary_.size() - 1)];
+}
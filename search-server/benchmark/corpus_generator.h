@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "document.h"
+
+struct CorpusOptions {
+    size_t document_count = 20000;
+    size_t min_document_length = 10;
+    size_t max_document_length = 60;
+    size_t vocabulary_size = 20000;
+    // word of rank r is drawn with probability proportional to 1 / r^zipf_exponent
+    double zipf_exponent = 1.0;
+    size_t stop_word_count = 20;
+    // share of document and query tokens that are stop words
+    double stop_word_ratio = 0.1;
+    // share of documents that repeat the word set of an earlier one
+    double duplicate_rate = 0.02;
+    size_t query_count = 2000;
+    size_t min_query_length = 1;
+    size_t max_query_length = 6;
+    // share of query words written as minus words
+    double minus_word_rate = 0.1;
+    uint64_t seed = 42;
+};
+
+/*
+ * Synthetic corpus and query log. Only the raw output of std::mt19937_64 is used (the standard
+ * fixes it), all distributions are computed here, so a seed gives the same corpus everywhere.
+ */
+class CorpusGenerator {
+    public:
+        explicit CorpusGenerator(const CorpusOptions& options);
+
+        std::string GetStopWords() const;
+
+        std::vector <DocumentRecord> GenerateDocuments();
+        std::vector <std::string> GenerateQueries();
+
+    private:
+        CorpusOptions options_;
+        std::mt19937_64 generator_;
+        std::vector <std::string> vocabulary_;
+        std::vector <std::string> stop_words_;
+        std::vector <double> zipf_cdf_;
+
+        double NextUnit();
+        size_t NextIndex(size_t count);
+        size_t NextInRange(size_t min_value, size_t max_value);
+
+        const std::string& NextWord();
+};
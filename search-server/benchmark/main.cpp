@@ -0,0 +1,497 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <execution>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "search_server.h"
+#include "document_loader.h"
+#include "metrics.h"
+#include "remove_duplicates.h"
+#include "request_queue.h"
+#include "search_cursor.h"
+#include "corpus_generator.h"
+
+using namespace std::literals;
+
+namespace {
+    std::atomic <uint64_t> heap_allocation_count{0};
+}
+
+// Every operator new in the process is counted, so each benchmark can report its heap allocations per call
+void* operator new(std::size_t size) {
+    heap_allocation_count.fetch_add(1, std::memory_order_relaxed);
+
+    if (void* pointer = std::malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+namespace {
+#ifdef SEARCH_SERVER_METRICS
+    constexpr bool METRICS_ENABLED = true;
+#else
+    constexpr bool METRICS_ENABLED = false;
+#endif
+
+    struct Measurement {
+        std::string name;
+        std::vector <double> latencies_us;
+        double total_ms = 0.0;
+        // what the calls returned, summed: equal corpora and equal code give equal checksums
+        size_t checksum = 0;
+        // operator new calls made by the calls, including the vectors they return
+        uint64_t heap_allocations = 0;
+    };
+
+    // What MaxScore left unread over one run of pruned sequential queries
+    struct PruningStats {
+        uint64_t postings_scanned = 0;
+        uint64_t postings_skipped = 0;
+    };
+
+    // Times every call operation(index) for index in [0, count); operation returns its contribution to the checksum
+    template <typename Operation>
+    Measurement Measure(std::string name, size_t count, Operation operation) {
+        Measurement measurement{std::move(name), {}, 0.0, 0, 0};
+        measurement.latencies_us.reserve(count);
+
+        const uint64_t start_allocations = heap_allocation_count.load(std::memory_order_relaxed);
+        const auto start = std::chrono::steady_clock::now();
+
+        for (size_t index = 0; index < count; ++index) {
+            const auto call_start = std::chrono::steady_clock::now();
+            measurement.checksum += operation(index);
+            measurement.latencies_us.push_back(std::chrono::duration <double, std::micro> (std::chrono::steady_clock::now() - call_start).count());
+        }
+
+        measurement.total_ms = std::chrono::duration <double, std::milli> (std::chrono::steady_clock::now() - start).count();
+        measurement.heap_allocations = heap_allocation_count.load(std::memory_order_relaxed) - start_allocations;
+        std::cerr << measurement.name << ": "s << measurement.total_ms << " ms"s << std::endl;
+
+        return measurement;
+    }
+
+    double Percentile(std::vector <double> values, double share) {
+        if (values.empty()) {
+            return 0.0;
+        }
+
+        const size_t position = std::min(values.size() - 1, static_cast <size_t> (share * values.size()));
+        std::nth_element(values.begin(), values.begin() + position, values.end());
+
+        return values[position];
+    }
+
+    std::string EscapeJson(std::string_view text) {
+        std::string escaped;
+
+        for (const char c : text) {
+            if (c == '"' || c == '\\') {
+                escaped.push_back('\\');
+            }
+
+            escaped.push_back(c);
+        }
+
+        return escaped;
+    }
+
+    std::string GetTokenizerIsaName(TokenizerIsa isa) {
+        switch (isa) {
+            case TokenizerIsa::AVX2:
+                return "avx2"s;
+            case TokenizerIsa::SSE2:
+                return "sse2"s;
+            case TokenizerIsa::SCALAR:
+                break;
+        }
+
+        return "scalar"s;
+    }
+
+    // The corpus in the line format DocumentLoader reads
+    std::string FormatCorpus(const std::vector <DocumentRecord>& documents) {
+        static const std::string status_names[] = {"ACTUAL"s, "IRRELEVANT"s, "BANNED"s, "REMOVED"s};
+        std::ostringstream corpus;
+
+        for (const DocumentRecord& document : documents) {
+            corpus << document.id << '\t' << status_names[static_cast <size_t> (document.status)] << '\t';
+
+            for (size_t index = 0; index < document.ratings.size(); ++index) {
+                corpus << (index > 0 ? " "s : ""s) << document.ratings[index];
+            }
+
+            corpus << '\t' << document.text << '\n';
+        }
+
+        return corpus.str();
+    }
+
+    void WriteJson(std::ostream& output, const CorpusOptions& options, size_t index_bytes, size_t indexed_documents, const LoadStats& ingestion,
+            const std::vector <Measurement>& measurements, const RequestQueue::RequestStats& request_stats, const MetricsSnapshot& query_metrics, const PruningStats& pruning) {
+        output << std::setprecision(6) << "{\n"s;
+        output << "  \"hardware_concurrency\": "s << std::thread::hardware_concurrency() << ",\n"s;
+        output << "  \"tokenizer_isa\": \""s << GetTokenizerIsaName(GetTokenizerIsa()) << "\",\n"s;
+        output << "  \"corpus\": {"s
+               << "\"documents\": "s << options.document_count
+               << ", \"min_document_length\": "s << options.min_document_length
+               << ", \"max_document_length\": "s << options.max_document_length
+               << ", \"vocabulary\": "s << options.vocabulary_size
+               << ", \"zipf_exponent\": "s << options.zipf_exponent
+               << ", \"stop_words\": "s << options.stop_word_count
+               << ", \"stop_word_ratio\": "s << options.stop_word_ratio
+               << ", \"duplicate_rate\": "s << options.duplicate_rate
+               << ", \"queries\": "s << options.query_count
+               << ", \"min_query_length\": "s << options.min_query_length
+               << ", \"max_query_length\": "s << options.max_query_length
+               << ", \"minus_word_rate\": "s << options.minus_word_rate
+               << ", \"seed\": "s << options.seed << "},\n"s;
+        // SearchServer::GetIndexByteSize once every document is added
+        output << "  \"index\": {\"bytes\": "s << index_bytes
+               << ", \"bytes_per_document\": "s << (indexed_documents == 0 ? 0.0 : static_cast <double> (index_bytes) / indexed_documents) << "},\n"s;
+        // DocumentLoader::Load of the whole corpus from memory
+        output << "  \"ingestion\": {\"bytes\": "s << ingestion.bytes_read
+               << ", \"documents\": "s << ingestion.documents_added
+               << ", \"errors\": "s << ingestion.errors.size()
+               << ", \"mb_per_second\": "s << ingestion.GetMegabytesPerSecond()
+               << ", \"documents_per_second\": "s << ingestion.GetDocumentsPerSecond() << "},\n"s;
+        output << "  \"benchmarks\": [\n"s;
+
+        for (size_t index = 0; index < measurements.size(); ++index) {
+            const Measurement& measurement = measurements[index];
+            const size_t iterations = measurement.latencies_us.size();
+
+            output << "    {\"name\": \""s << EscapeJson(measurement.name) << "\""s
+                   << ", \"iterations\": "s << iterations
+                   << ", \"total_ms\": "s << measurement.total_ms
+                   << ", \"mean_us\": "s << (iterations == 0 ? 0.0 : measurement.total_ms * 1000.0 / iterations)
+                   << ", \"p50_us\": "s << Percentile(measurement.latencies_us, 0.5)
+                   << ", \"p90_us\": "s << Percentile(measurement.latencies_us, 0.9)
+                   << ", \"p99_us\": "s << Percentile(measurement.latencies_us, 0.99)
+                   << ", \"max_us\": "s << Percentile(measurement.latencies_us, 1.0)
+                   << ", \"allocations_per_call\": "s << (iterations == 0 ? 0.0 : static_cast <double> (measurement.heap_allocations) / iterations)
+                   << ", \"checksum\": "s << measurement.checksum << "}"s
+                   << (index + 1 < measurements.size() ? ",\n"s : "\n"s);
+        }
+
+        output << "  ],\n"s;
+        // the async run's sliding window: submission to result, queueing included
+        output << "  \"request_queue\": {\"requests\": "s << request_stats.request_count
+               << ", \"no_result\": "s << request_stats.no_result_count
+               << ", \"p50_us\": "s << request_stats.p50_us
+               << ", \"p90_us\": "s << request_stats.p90_us
+               << ", \"p99_us\": "s << request_stats.p99_us
+               << ", \"max_us\": "s << request_stats.max_us
+               << ", \"rejected\": "s << request_stats.rejected_count << "},\n"s;
+
+        // stage breakdown over all the FindTopDocuments runs above
+        if (METRICS_ENABLED) {
+            output << "  \"query_metrics\": {\n"s;
+
+            for (size_t counter = 0; counter < METRIC_COUNTER_COUNT; ++counter) {
+                output << "    \""s << GetMetricName(static_cast <MetricCounter> (counter)) << "\": "s << query_metrics.counters[counter] << ",\n"s;
+            }
+
+            for (size_t histogram = 0; histogram < METRIC_HISTOGRAM_COUNT; ++histogram) {
+                const HistogramSummary& summary = query_metrics.histograms[histogram];
+
+                output << "    \""s << GetMetricName(static_cast <MetricHistogram> (histogram)) << "\": {"s
+                       << "\"count\": "s << summary.count << ", \"sum\": "s << summary.sum
+                       << ", \"p50\": "s << summary.p50 << ", \"p99\": "s << summary.p99
+                       << ", \"p999\": "s << summary.p999 << ", \"max\": "s << summary.max << "}"s
+                       << (histogram + 1 < METRIC_HISTOGRAM_COUNT ? ",\n"s : "\n"s);
+            }
+
+            output << "  },\n"s;
+
+            const uint64_t postings_total = pruning.postings_scanned + pruning.postings_skipped;
+
+            output << "  \"pruning\": {\"postings_scanned\": "s << pruning.postings_scanned
+                   << ", \"postings_skipped\": "s << pruning.postings_skipped
+                   << ", \"postings_skipped_ratio\": "s << (postings_total == 0 ? 0.0 : static_cast <double> (pruning.postings_skipped) / postings_total) << "},\n"s;
+        }
+
+        output << "  \"metrics_enabled\": "s << (METRICS_ENABLED ? "true"s : "false"s) << "\n}\n"s;
+    }
+
+    void PrintUsage() {
+        std::cerr << "usage: search_server_benchmark [--documents=N] [--min-length=N] [--max-length=N] [--vocabulary=N] [--zipf=S]\n"s
+                  << "       [--stop-words=N] [--stop-ratio=R] [--duplicate-rate=R] [--queries=N] [--min-query-length=N]\n"s
+                  << "       [--max-query-length=N] [--minus-rate=R] [--seed=N] [--output=PATH]\n"s
+                  << "Writes the results as JSON to PATH, or to stdout; progress goes to stderr."s << std::endl;
+    }
+
+    bool ParseArguments(int argc, char* argv[], CorpusOptions& options, std::string& output_path) {
+        for (int index = 1; index < argc; ++index) {
+            const std::string_view argument = argv[index];
+            const size_t separator = argument.find('=');
+
+            if (argument.substr(0, 2) != "--"sv || separator == std::string_view::npos) {
+                return false;
+            }
+
+            const std::string_view key = argument.substr(2, separator - 2);
+            const std::string value(argument.substr(separator + 1));
+
+            if (key == "output"sv) {
+                output_path = value;
+            } else if (key == "documents"sv) {
+                options.document_count = std::stoul(value);
+            } else if (key == "min-length"sv) {
+                options.min_document_length = std::stoul(value);
+            } else if (key == "max-length"sv) {
+                options.max_document_length = std::stoul(value);
+            } else if (key == "vocabulary"sv) {
+                options.vocabulary_size = std::stoul(value);
+            } else if (key == "zipf"sv) {
+                options.zipf_exponent = std::stod(value);
+            } else if (key == "stop-words"sv) {
+                options.stop_word_count = std::stoul(value);
+            } else if (key == "stop-ratio"sv) {
+                options.stop_word_ratio = std::stod(value);
+            } else if (key == "duplicate-rate"sv) {
+                options.duplicate_rate = std::stod(value);
+            } else if (key == "queries"sv) {
+                options.query_count = std::stoul(value);
+            } else if (key == "min-query-length"sv) {
+                options.min_query_length = std::stoul(value);
+            } else if (key == "max-query-length"sv) {
+                options.max_query_length = std::stoul(value);
+            } else if (key == "minus-rate"sv) {
+                options.minus_word_rate = std::stod(value);
+            } else if (key == "seed"sv) {
+                options.seed = std::stoull(value);
+            } else {
+                return false;
+            }
+        }
+
+        return options.document_count > 0 && options.query_count > 0 && options.min_document_length > 0 && options.min_query_length > 0;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    CorpusOptions options;
+    std::string output_path;
+
+    try {
+        if (!ParseArguments(argc, argv, options, output_path)) {
+            PrintUsage();
+            return 1;
+        }
+    } catch (const std::exception&) {
+        PrintUsage();
+        return 1;
+    }
+
+    CorpusGenerator generator(options);
+    const std::string stop_words = generator.GetStopWords();
+    const std::vector <DocumentRecord> documents = generator.GenerateDocuments();
+    const std::vector <std::string> queries = generator.GenerateQueries();
+
+    std::vector <Measurement> measurements;
+
+    // the vectorized tokenizer this CPU picks against the byte-at-a-time one
+    measurements.push_back(Measure("TokenizeText(document)"s, documents.size(), [&](size_t index) {
+        return TokenizeText(documents[index].text).words.size();
+    }));
+    measurements.push_back(Measure("TokenizeText(scalar, document)"s, documents.size(), [&](size_t index) {
+        return TokenizeText(TokenizerIsa::SCALAR, documents[index].text).words.size();
+    }));
+
+    {
+        SearchServer search_server(stop_words);
+
+        measurements.push_back(Measure("AddDocuments"s, 1, [&](size_t) {
+            return search_server.AddDocuments(documents).size();
+        }));
+    }
+
+    LoadStats ingestion;
+
+    {
+        SearchServer search_server(stop_words);
+        const std::string corpus = FormatCorpus(documents);
+
+        measurements.push_back(Measure("DocumentLoader::Load"s, 1, [&](size_t) {
+            std::istringstream input(corpus);
+            ingestion = DocumentLoader(search_server).Load(input);
+            return ingestion.documents_added;
+        }));
+    }
+
+    SearchServer search_server(stop_words);
+
+    measurements.push_back(Measure("AddDocument"s, documents.size(), [&](size_t index) {
+        search_server.AddDocument(documents[index].id, documents[index].text, documents[index].status, documents[index].ratings);
+        return size_t(1);
+    }));
+
+    const size_t index_bytes = search_server.GetIndexByteSize();
+    const size_t indexed_documents = search_server.GetDocumentCount();
+
+    auto positive_rating = [](int document_id, DocumentStatus status, int rating) {
+        return rating > 0;
+    };
+
+    auto run_queries = [&](const std::string& name, auto find_top_documents) {
+        measurements.push_back(Measure(name, queries.size(), [&](size_t index) {
+            return find_top_documents(queries[index]).size();
+        }));
+    };
+
+    MetricsRegistry::Instance().Reset();
+
+    run_queries("FindTopDocuments(query)"s, [&](const std::string& query) { return search_server.FindTopDocuments(query); });
+    run_queries("FindTopDocuments(query, status)"s, [&](const std::string& query) { return search_server.FindTopDocuments(query, DocumentStatus::BANNED); });
+    run_queries("FindTopDocuments(query, predicate)"s, [&](const std::string& query) { return search_server.FindTopDocuments(query, positive_rating); });
+    const MetricsSnapshot before_pruned_run = MetricsRegistry::Instance().TakeSnapshot();
+    run_queries("FindTopDocuments(seq, query)"s, [&](const std::string& query) { return search_server.FindTopDocuments(std::execution::seq, query); });
+    const MetricsSnapshot after_pruned_run = MetricsRegistry::Instance().TakeSnapshot();
+
+    const PruningStats pruning{
+        after_pruned_run.GetCounter(MetricCounter::POSTINGS_SCANNED) - before_pruned_run.GetCounter(MetricCounter::POSTINGS_SCANNED),
+        after_pruned_run.GetCounter(MetricCounter::POSTINGS_SKIPPED) - before_pruned_run.GetCounter(MetricCounter::POSTINGS_SKIPPED)};
+
+    // the same queries with every matching document scored, for comparison
+    const SearchOptions exhaustive{MAX_RESULT_DOCUMENT_COUNT, false};
+    run_queries("FindTopDocuments(seq, query, exhaustive)"s, [&](const std::string& query) { return search_server.FindTopDocuments(std::execution::seq, query, exhaustive); });
+    run_queries("FindTopDocuments(seq, query, status)"s, [&](const std::string& query) { return search_server.FindTopDocuments(std::execution::seq, query, DocumentStatus::BANNED); });
+    run_queries("FindTopDocuments(seq, query, predicate)"s, [&](const std::string& query) { return search_server.FindTopDocuments(std::execution::seq, query, positive_rating); });
+    run_queries("FindTopDocuments(par, query)"s, [&](const std::string& query) { return search_server.FindTopDocuments(std::execution::par, query); });
+    run_queries("FindTopDocuments(par, query, status)"s, [&](const std::string& query) { return search_server.FindTopDocuments(std::execution::par, query, DocumentStatus::BANNED); });
+    run_queries("FindTopDocuments(par, query, predicate)"s, [&](const std::string& query) { return search_server.FindTopDocuments(std::execution::par, query, positive_rating); });
+
+    const MetricsSnapshot query_metrics = MetricsRegistry::Instance().TakeSnapshot();
+
+    // the same queries parsed and resolved once, up front
+    std::vector <PreparedQuery> prepared_queries;
+
+    for (const std::string& query : queries) {
+        prepared_queries.push_back(search_server.Prepare(query));
+    }
+
+    measurements.push_back(Measure("FindTopDocuments(prepared query)"s, queries.size(), [&](size_t index) {
+        return search_server.FindTopDocuments(prepared_queries[index]).size();
+    }));
+    measurements.push_back(Measure("FindTopDocuments(prepared query, status)"s, queries.size(), [&](size_t index) {
+        return search_server.FindTopDocuments(prepared_queries[index], DocumentStatus::BANNED).size();
+    }));
+
+    // the first 40 pages of 10: a cursor against ranking the top page_count * 10 again for every page
+    const size_t page_count = 40;
+
+    run_queries("SearchCursor::NextPage(40 pages)"s, [&](const std::string& query) {
+        auto cursor = OpenCursor(search_server, query, 10);
+        std::vector <Document> documents;
+
+        for (size_t page = 0; page < page_count; ++page) {
+            const std::vector <Document> page_documents = cursor.NextPage();
+            documents.insert(documents.end(), page_documents.begin(), page_documents.end());
+        }
+
+        return documents;
+    });
+    run_queries("FindTopDocuments(40 pages, re-ranked)"s, [&](const std::string& query) {
+        std::vector <Document> documents;
+
+        for (size_t page = 0; page < page_count; ++page) {
+            const std::vector <Document> top_documents = search_server.FindTopDocuments(query, SearchOptions{(page + 1) * 10});
+
+            if (top_documents.size() > page * 10) {
+                documents.insert(documents.end(), top_documents.begin() + page * 10, top_documents.end());
+            }
+        }
+
+        return documents;
+    });
+
+    // every query submitted at once, then all results awaited: throughput of the pool behind the queue
+    RequestQueue::RequestStats request_stats;
+
+    {
+        RequestQueue request_queue(search_server, 0, {0, queries.size()});
+
+        measurements.push_back(Measure("RequestQueue::AddFindRequestAsync"s, 1, [&](size_t) {
+            std::vector <std::future <std::vector <Document>>> results;
+            size_t document_count = 0;
+
+            for (const std::string& query : queries) {
+                results.push_back(request_queue.AddFindRequestAsync(query));
+            }
+
+            for (std::future <std::vector <Document>>& result : results) {
+                document_count += result.get().size();
+            }
+
+            return document_count;
+        }));
+
+        request_stats = request_queue.GetRequestStats();
+    }
+
+    auto matched_document = [&](size_t index) {
+        return documents[index * 7919 % documents.size()].id;
+    };
+
+    measurements.push_back(Measure("MatchDocument(query, id)"s, queries.size(), [&](size_t index) {
+        return std::get <0> (search_server.MatchDocument(queries[index], matched_document(index))).size();
+    }));
+    measurements.push_back(Measure("MatchDocument(seq, query, id)"s, queries.size(), [&](size_t index) {
+        return std::get <0> (search_server.MatchDocument(std::execution::seq, queries[index], matched_document(index))).size();
+    }));
+    measurements.push_back(Measure("MatchDocument(par, query, id)"s, queries.size(), [&](size_t index) {
+        return std::get <0> (search_server.MatchDocument(std::execution::par, queries[index], matched_document(index))).size();
+    }));
+
+    measurements.push_back(Measure("RemoveDuplicates"s, 1, [&](size_t) {
+        return RemoveDuplicates(search_server).size();
+    }));
+
+    const std::vector <int> remaining_ids(search_server.begin(), search_server.end());
+    const size_t removal_count = std::min(queries.size(), remaining_ids.size());
+
+    measurements.push_back(Measure("RemoveDocument"s, removal_count, [&](size_t index) {
+        search_server.RemoveDocument(remaining_ids[index * remaining_ids.size() / removal_count]);
+        return size_t(1);
+    }));
+
+    measurements.push_back(Measure("Compact"s, 1, [&](size_t) {
+        return search_server.Compact().removed_postings;
+    }));
+
+    if (output_path.empty()) {
+        WriteJson(std::cout, options, index_bytes, indexed_documents, ingestion, measurements, request_stats, query_metrics, pruning);
+    } else {
+        std::ofstream output(output_path);
+        WriteJson(output, options, index_bytes, indexed_documents, ingestion, measurements, request_stats, query_metrics, pruning);
+
+        if (!output) {
+            std::cerr << "cannot write "s << output_path << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
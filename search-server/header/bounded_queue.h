@@ -0,0 +1,68 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+// Blocking FIFO of at most capacity items between two pipeline stages: a producer that gets
+// ahead of its consumer waits. Close wakes both sides; Push fails from then on, Pop first hands
+// out what is left.
+template <typename T>
+class BoundedQueue {
+    public:
+        explicit BoundedQueue(size_t capacity)
+            : capacity_(capacity > 0 ? capacity : 1)
+        {}
+
+        BoundedQueue(const BoundedQueue&) = delete;
+        BoundedQueue& operator= (const BoundedQueue&) = delete;
+
+        // false when the queue was closed; the item is dropped
+        bool Push(T item) {
+            std::unique_lock <std::mutex> lock(mutex_);
+            not_full_.wait(lock, [this]() { return is_closed_ || items_.size() < capacity_; });
+
+            if (is_closed_) {
+                return false;
+            }
+
+            items_.push_back(std::move(item));
+            not_empty_.notify_one();
+
+            return true;
+        }
+
+        // std::nullopt once the queue is closed and empty
+        std::optional <T> Pop() {
+            std::unique_lock <std::mutex> lock(mutex_);
+            not_empty_.wait(lock, [this]() { return is_closed_ || !items_.empty(); });
+
+            if (items_.empty()) {
+                return std::nullopt;
+            }
+
+            std::optional <T> item(std::move(items_.front()));
+            items_.pop_front();
+            not_full_.notify_one();
+
+            return item;
+        }
+
+        void Close() {
+            std::lock_guard <std::mutex> guard(mutex_);
+            is_closed_ = true;
+            not_full_.notify_all();
+            not_empty_.notify_all();
+        }
+
+    private:
+        std::mutex mutex_;
+        std::condition_variable not_full_;
+        std::condition_variable not_empty_;
+        std::deque <T> items_;
+        size_t capacity_;
+        bool is_closed_ = false;
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "search_server.h"
+#include "document.h"
+
+/*
+ * Thread-safe server for many readers and a stream of writes. Two identical SearchServer
+ * instances are kept: readers pin the published one and never wait, while a write goes to
+ * the other, is published, and, once the last reader of the retired instance has left,
+ * is replayed on it. Readers see every write completely or not at all.
+ * The price is twice the memory and every write applied twice.
+ */
+class ConcurrentSearchServer {
+    private:
+        struct Instance {
+            template <typename StopWords>
+            explicit Instance(const StopWords& stop_words)
+                : server(stop_words) {}
+
+            SearchServer server;
+            std::atomic <size_t> reader_count{0};
+        };
+
+    public:
+        // Pins one version of the index; views obtained from it stay valid while it is held.
+        // A thread must release its snapshot before it writes, or the write waits for it forever.
+        class Snapshot {
+            public:
+                Snapshot(const Snapshot&) = delete;
+                Snapshot& operator= (const Snapshot&) = delete;
+                Snapshot(Snapshot&& other) noexcept;
+                Snapshot& operator= (Snapshot&&) = delete;
+                ~Snapshot();
+
+                const SearchServer& operator* () const;
+                const SearchServer* operator-> () const;
+
+            private:
+                friend class ConcurrentSearchServer;
+
+                explicit Snapshot(Instance* instance);
+
+                Instance* instance_;
+        };
+
+        template <typename StringCollection>
+        explicit ConcurrentSearchServer(const StringCollection& stop_words);
+        explicit ConcurrentSearchServer(const std::string& stop_words);
+        explicit ConcurrentSearchServer(std::string_view stop_words);
+
+        Snapshot AcquireSnapshot() const;
+
+        void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector <int>& ratings);
+        std::vector <DocumentError> AddDocuments(const std::vector <DocumentRecord>& documents);
+        void RemoveDocument(int document_id);
+        void RemoveDocuments(const std::vector <int>& document_ids);
+        CompactionStats Compact();
+
+        // Shorthand for a query on a fresh snapshot
+        template <typename... Args>
+        std::vector <Document> FindTopDocuments(Args&&... args) const;
+
+        int GetDocumentCount() const;
+
+    private:
+        std::mutex write_mutex_;
+        std::unique_ptr <Instance> instances_[2];
+        std::atomic <Instance*> published_;
+
+        // write must leave both instances equal when applied to each; if it throws on the first, nothing is published
+        template <typename Write>
+        void ApplyWrite(Write write);
+};
+
+template <typename StringCollection>
+ConcurrentSearchServer::ConcurrentSearchServer(const StringCollection& stop_words)
+    : instances_{std::make_unique <Instance> (stop_words), std::make_unique <Instance> (stop_words)}
+    , published_(instances_[0].get())
+{}
+
+template <typename... Args>
+std::vector <Document> ConcurrentSearchServer::FindTopDocuments(Args&&... args) const {
+    return AcquireSnapshot()->FindTopDocuments(std::forward <Args> (args)...);
+}
+
+template <typename Write>
+void ConcurrentSearchServer::ApplyWrite(Write write) {
+    std::lock_guard <std::mutex> guard(write_mutex_);
+
+    Instance* standby = published_.load() == instances_[0].get() ? instances_[1].get() : instances_[0].get();
+    write(standby->server);
+
+    Instance* retired = published_.exchange(standby);
+
+    // grace period: readers that pinned the retired instance before the exchange finish their queries
+    while (retired->reader_count.load() != 0) {
+        std::this_thread::yield();
+    }
+
+    write(retired->server);
+}
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
 
 using namespace std::string_literals;
 
@@ -16,4 +17,19 @@ struct Document {
     int rating;
 };
 
+// One document of a bulk load
+struct DocumentRecord {
+    int id = 0;
+    std::string text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector <int> ratings;
+};
+
+// A document of a bulk load that was rejected; index is its position in the batch
+struct DocumentError {
+    size_t index = 0;
+    int document_id = 0;
+    std::string message;
+};
+
 std::ostream& operator<< (std::ostream& os, const Document& document);
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+// One line of a corpus, tab-separated:  id <TAB> status <TAB> ratings <TAB> text
+// status is ACTUAL, IRRELEVANT, BANNED or REMOVED; ratings are space-separated integers, maybe none.
+// A trailing '\r' is dropped. Throws std::invalid_argument naming the malformed field.
+DocumentRecord ParseDocumentLine(std::string_view line);
+
+struct LoadOptions {
+    // text handed down the pipeline at a time
+    size_t batch_bytes = size_t{4} << 20;
+    // batches a stage may run ahead of the next one
+    size_t queue_capacity = 2;
+};
+
+// A line that was not added: malformed, or rejected by the server (see AddDocuments)
+struct LineError {
+    size_t line_number = 0;
+    std::string message;
+};
+
+struct LoadStats {
+    size_t bytes_read = 0;
+    size_t lines_read = 0;
+    size_t documents_added = 0;
+    double seconds = 0.0;
+    // in line order
+    std::vector <LineError> errors;
+
+    double GetMegabytesPerSecond() const;
+    double GetDocumentsPerSecond() const;
+};
+
+/*
+ * Streams a corpus into a server as a three-stage pipeline: a reader thread cuts the input into
+ * batches of lines and parses them, a tokenizer thread builds each batch's partial indexes, and
+ * the calling thread merges them. Stages hand batches over through bounded queues, so at most
+ * a few batches are in memory however big the input is. Blank lines are skipped, bad lines are
+ * reported with their numbers and the load goes on; the outcome equals one AddDocuments call
+ * with the whole corpus. The server must not be used by anyone else during a load.
+ */
+class DocumentLoader {
+    public:
+        explicit DocumentLoader(SearchServer& search_server, const LoadOptions& options = {});
+
+        // Read in large blocks, e.g. std::cin
+        LoadStats Load(std::istream& input);
+        // Mapped into memory; std::runtime_error when it cannot be opened
+        LoadStats LoadFile(const std::string& path);
+
+    private:
+        struct Batch;
+
+        SearchServer& search_server_;
+        LoadOptions options_;
+
+        // read_lines(on_line) calls on_line for every line in order and stops once it returns false
+        template <typename ReadLines>
+        LoadStats Run(ReadLines read_lines);
+};
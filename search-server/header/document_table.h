@@ -0,0 +1,196 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include "document.h"
+
+/*
+ * Per-document metadata in dense columns indexed by an ordinal handed out in insertion order,
+ * so scoring reads a rating or a word count with one load instead of walking a tree. An id is
+ * mapped to its ordinal through pages of 4096 slots allocated on first use. Every status has a
+ * bit per ordinal, set only while the document is live, so a status filter is a single bit test.
+ * A removed document keeps its ordinal and term ids until it is released or compacted away.
+ * The term ids of the first rows may view a snapshot's forward index instead of owning vectors;
+ * they are copied out when terms are renumbered or the table is compacted.
+ */
+class DocumentTable {
+    public:
+        static constexpr uint32_t NO_ORDINAL = UINT32_MAX;
+
+        // A document's term ids, owned by the table or viewed in a snapshot
+        class TermIdSpan {
+            public:
+                TermIdSpan(const uint32_t* data, size_t size) : data_(data), size_(size) {}
+
+                const uint32_t* begin() const { return data_; }
+                const uint32_t* end() const { return data_ + size_; }
+                size_t size() const { return size_; }
+                bool empty() const { return size_ == 0; }
+                uint32_t operator[] (size_t index) const { return data_[index]; }
+
+            private:
+                const uint32_t* data_;
+                size_t size_;
+        };
+
+        // Live ids in ascending order, found by walking the ordinal pages
+        class LiveIdIterator {
+            public:
+                using iterator_category = std::forward_iterator_tag;
+                using value_type = int;
+                using difference_type = std::ptrdiff_t;
+                using pointer = const int*;
+                using reference = const int&;
+
+                LiveIdIterator() = default;
+
+                // -1 at the end
+                reference operator* () const { return document_id_; }
+                pointer operator-> () const { return &document_id_; }
+                LiveIdIterator& operator++ ();
+                LiveIdIterator operator++ (int);
+
+                bool operator== (const LiveIdIterator& other) const { return document_id_ == other.document_id_; }
+                bool operator!= (const LiveIdIterator& other) const { return !(*this == other); }
+
+            private:
+                friend class DocumentTable;
+
+                // at the first live id from document_id on, or the end
+                LiveIdIterator(const DocumentTable* documents, int64_t document_id);
+
+                const DocumentTable* documents_ = nullptr;
+                int document_id_ = -1;
+
+                void SkipDead(int64_t document_id);
+        };
+
+        DocumentTable() = default;
+        DocumentTable(const DocumentTable&) = delete;
+        DocumentTable& operator= (const DocumentTable&) = delete;
+        DocumentTable(DocumentTable&&) = default;
+        DocumentTable& operator= (DocumentTable&&) = default;
+
+        // The id must not have an ordinal yet
+        uint32_t Add(int document_id, int rating, DocumentStatus status, uint32_t word_count, std::vector <uint32_t> term_ids);
+
+        // Live or removed; NO_ORDINAL for an id never added, released or compacted away
+        uint32_t Find(int document_id) const;
+        uint32_t FindLive(int document_id) const;
+
+        bool IsLive(uint32_t ordinal) const;
+        // Live and with that status
+        bool HasStatus(uint32_t ordinal, DocumentStatus status) const;
+
+        int GetId(uint32_t ordinal) const;
+        int GetRating(uint32_t ordinal) const;
+        DocumentStatus GetStatus(uint32_t ordinal) const;
+        uint32_t GetWordCount(uint32_t ordinal) const;
+        TermIdSpan GetTermIds(uint32_t ordinal) const;
+
+        // Replaces every term id t by new_term_ids[t]
+        void RenumberTerms(const std::vector <uint32_t>& new_term_ids);
+
+        // Adds count live rows to an empty table: row i has ids[i] and so on, and views the term ids
+        // term_ids[term_offsets[i], term_offsets[i + 1]) in place. The ids must be distinct and
+        // non-negative; the term arrays must outlive the table or its next Compact.
+        void ViewRows(size_t count, const int32_t* ids, const int32_t* ratings, const int32_t* statuses, const uint32_t* word_counts,
+                const uint64_t* term_offsets, const uint32_t* term_ids);
+
+        LiveIdIterator begin() const;
+        LiveIdIterator end() const;
+        // Only while some document is live
+        int GetMinLiveId() const;
+        int GetMaxLiveId() const;
+
+        void MarkRemoved(uint32_t ordinal);
+        // Forgets a removed document's id and terms; the dead ordinal stays until Compact
+        void Release(int document_id);
+        // Drops every removed document; the live ones keep their relative order
+        void Compact();
+
+        // Ordinals in use, removed documents included
+        size_t size() const;
+        size_t GetLiveCount() const;
+
+        size_t GetByteSize() const;
+
+    private:
+        static constexpr size_t PAGE_BITS = 12;
+        static constexpr size_t PAGE_SIZE = size_t{1} << PAGE_BITS;
+        static constexpr size_t STATUS_COUNT = static_cast <size_t> (DocumentStatus::REMOVED) + 1;
+
+        std::vector <std::unique_ptr <uint32_t[]>> ordinal_pages_;
+        std::vector <int> ids_;
+        std::vector <int> ratings_;
+        std::vector <DocumentStatus> statuses_;
+        std::vector <uint32_t> word_counts_;
+        // rows from mapped_row_count_ on
+        std::vector <std::vector <uint32_t>> term_ids_;
+        const uint64_t* mapped_term_offsets_ = nullptr;
+        const uint32_t* mapped_term_ids_ = nullptr;
+        size_t mapped_row_count_ = 0;
+        std::vector <bool> live_;
+        std::array <std::vector <bool>, STATUS_COUNT> status_bits_;
+        size_t live_count_ = 0;
+        int min_live_id_ = 0;
+        int max_live_id_ = 0;
+
+        uint32_t& GetOrdinalSlot(int document_id);
+        void DetachTermIds();
+};
+
+// Defined here so the scoring loops inline them
+
+inline uint32_t DocumentTable::Find(int document_id) const {
+    const size_t page = static_cast <size_t> (document_id) >> PAGE_BITS;
+
+    if (document_id < 0 || page >= ordinal_pages_.size() || ordinal_pages_[page] == nullptr) {
+        return NO_ORDINAL;
+    }
+
+    return ordinal_pages_[page][document_id & (PAGE_SIZE - 1)];
+}
+
+inline uint32_t DocumentTable::FindLive(int document_id) const {
+    const uint32_t ordinal = Find(document_id);
+    return ordinal != NO_ORDINAL && live_[ordinal] ? ordinal : NO_ORDINAL;
+}
+
+inline bool DocumentTable::IsLive(uint32_t ordinal) const {
+    return live_[ordinal];
+}
+
+inline bool DocumentTable::HasStatus(uint32_t ordinal, DocumentStatus status) const {
+    return status_bits_[static_cast <size_t> (status)][ordinal];
+}
+
+inline int DocumentTable::GetId(uint32_t ordinal) const {
+    return ids_[ordinal];
+}
+
+inline int DocumentTable::GetRating(uint32_t ordinal) const {
+    return ratings_[ordinal];
+}
+
+inline DocumentStatus DocumentTable::GetStatus(uint32_t ordinal) const {
+    return statuses_[ordinal];
+}
+
+inline uint32_t DocumentTable::GetWordCount(uint32_t ordinal) const {
+    return word_counts_[ordinal];
+}
+
+inline DocumentTable::TermIdSpan DocumentTable::GetTermIds(uint32_t ordinal) const {
+    if (ordinal < mapped_row_count_) {
+        return {mapped_term_ids_ + mapped_term_offsets_[ordinal], static_cast <size_t> (mapped_term_offsets_[ordinal + 1] - mapped_term_offsets_[ordinal])};
+    }
+
+    const std::vector <uint32_t>& term_ids = term_ids_[ordinal - mapped_row_count_];
+    return {term_ids.data(), term_ids.size()};
+}
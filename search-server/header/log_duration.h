@@ -7,6 +7,7 @@
 
 #include <iostream>
 #include <chrono>
+#include <string>
 
 using namespace std::literals;
 
@@ -21,10 +22,11 @@ class LogDuration {
         const std::string call_name;
 };
 
-LogDuration::LogDuration() {}
+// inline: the header is included from several translation units
+inline LogDuration::LogDuration() {}
 
-LogDuration::LogDuration(const std::string name) : call_name(name) {};
+inline LogDuration::LogDuration(const std::string name) : call_name(name) {};
 
-LogDuration::~LogDuration() {
+inline LogDuration::~LogDuration() {
     std::cerr << call_name << ": "s << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time_).count() << " ms"s << std::endl;
 }
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Read-only view of a whole file: mmap'd where POSIX is available, read into memory elsewhere
+class MappedFile {
+    public:
+        explicit MappedFile(const std::string& path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator= (const MappedFile&) = delete;
+
+        const char* data() const;
+        size_t size() const;
+
+    private:
+        const char* data_ = nullptr;
+        size_t size_ = 0;
+        bool is_mapped_ = false;
+        std::vector <char> buffer_;
+};
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+enum class MetricCounter {
+    QUERIES,
+    POSTINGS_SCANNED,
+    // postings of the plus words that pruned evaluation never scored
+    POSTINGS_SKIPPED,
+    DOCUMENTS_MATCHED,
+    COUNT
+};
+
+enum class MetricHistogram {
+    // nanoseconds
+    QUERY_TOTAL,
+    QUERY_VALIDATION,
+    QUERY_PARSE,
+    QUERY_ACCUMULATION,
+    QUERY_MINUS_FILTER,
+    QUERY_RANKING,
+    // per query
+    POSTINGS_PER_QUERY,
+    DOCUMENTS_PER_QUERY,
+    COUNT
+};
+
+constexpr size_t METRIC_COUNTER_COUNT = static_cast <size_t> (MetricCounter::COUNT);
+constexpr size_t METRIC_HISTOGRAM_COUNT = static_cast <size_t> (MetricHistogram::COUNT);
+
+const char* GetMetricName(MetricCounter counter);
+const char* GetMetricName(MetricHistogram histogram);
+
+struct HistogramSummary {
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+    uint64_t p50 = 0;
+    uint64_t p99 = 0;
+    uint64_t p999 = 0;
+};
+
+struct MetricsSnapshot {
+    std::array <uint64_t, METRIC_COUNTER_COUNT> counters = {};
+    std::array <HistogramSummary, METRIC_HISTOGRAM_COUNT> histograms = {};
+
+    uint64_t GetCounter(MetricCounter counter) const;
+    const HistogramSummary& GetHistogram(MetricHistogram histogram) const;
+};
+
+void PrintMetrics(std::ostream& output, const MetricsSnapshot& snapshot);
+
+/*
+ * Every thread records into its own slot, so recording is a couple of uncontended relaxed
+ * stores; the registry lock is only taken when a thread records for the first time, when it
+ * exits (its totals are folded into the registry) and by TakeSnapshot/Reset.
+ * Histograms are log-linear: 8 linear buckets per power of two, so quantiles are within 12.5%.
+ */
+class MetricsRegistry {
+    public:
+        static constexpr size_t SUB_BUCKET_BITS = 3;
+        static constexpr size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS;
+
+        static MetricsRegistry& Instance();
+
+        void Add(MetricCounter counter, uint64_t value);
+        void Record(MetricHistogram histogram, uint64_t value);
+
+        MetricsSnapshot TakeSnapshot() const;
+        // Values recorded at the same moment by other threads may survive the reset
+        void Reset();
+
+        static size_t GetBucketIndex(uint64_t value);
+        static uint64_t GetBucketUpperBound(size_t bucket);
+
+    private:
+        struct ThreadMetrics {
+            std::array <std::atomic <uint64_t>, METRIC_COUNTER_COUNT> counters = {};
+            std::array <std::array <std::atomic <uint64_t>, BUCKET_COUNT>, METRIC_HISTOGRAM_COUNT> buckets = {};
+            std::array <std::atomic <uint64_t>, METRIC_HISTOGRAM_COUNT> sums = {};
+            std::array <std::atomic <uint64_t>, METRIC_HISTOGRAM_COUNT> maxes = {};
+        };
+
+        class ThreadSlot;
+
+        mutable std::mutex mutex_;
+        std::vector <ThreadMetrics*> threads_;
+        ThreadMetrics retired_;
+
+        MetricsRegistry() = default;
+
+        ThreadMetrics& GetThreadMetrics();
+
+        void Register(ThreadMetrics* thread_metrics);
+        void Retire(ThreadMetrics* thread_metrics);
+
+        static void MergeInto(ThreadMetrics& target, const ThreadMetrics& source);
+        static void Clear(ThreadMetrics& thread_metrics);
+};
+
+// Records the lifetime of the scope into a histogram, in nanoseconds
+class ScopedMetricsTimer {
+    public:
+        explicit ScopedMetricsTimer(MetricHistogram histogram)
+            : histogram_(histogram) {}
+
+        ScopedMetricsTimer(const ScopedMetricsTimer&) = delete;
+        ScopedMetricsTimer& operator= (const ScopedMetricsTimer&) = delete;
+
+        ~ScopedMetricsTimer() {
+            MetricsRegistry::Instance().Record(histogram_, std::chrono::duration_cast <std::chrono::nanoseconds> (std::chrono::steady_clock::now() - start_time_).count());
+        }
+
+    private:
+        MetricHistogram histogram_;
+        std::chrono::steady_clock::time_point start_time_ = std::chrono::steady_clock::now();
+};
+
+// Records the summed lifetime of many short scopes, such as a probe made for every candidate, as one
+// sample when it goes out of scope. The scopes may run on several threads.
+class AccumulatedMetricsTimer {
+    public:
+        // Adds the lifetime of its own scope to the timer
+        class Lap {
+            public:
+                explicit Lap(AccumulatedMetricsTimer& timer)
+                    : timer_(timer) {}
+
+                Lap(const Lap&) = delete;
+                Lap& operator= (const Lap&) = delete;
+
+                ~Lap() {
+                    timer_.total_.fetch_add(std::chrono::duration_cast <std::chrono::nanoseconds> (std::chrono::steady_clock::now() - start_time_).count(), std::memory_order_relaxed);
+                }
+
+            private:
+                AccumulatedMetricsTimer& timer_;
+                std::chrono::steady_clock::time_point start_time_ = std::chrono::steady_clock::now();
+        };
+
+        explicit AccumulatedMetricsTimer(MetricHistogram histogram)
+            : histogram_(histogram) {}
+
+        AccumulatedMetricsTimer(const AccumulatedMetricsTimer&) = delete;
+        AccumulatedMetricsTimer& operator= (const AccumulatedMetricsTimer&) = delete;
+
+        ~AccumulatedMetricsTimer() {
+            MetricsRegistry::Instance().Record(histogram_, total_.load(std::memory_order_relaxed));
+        }
+
+    private:
+        MetricHistogram histogram_;
+        std::atomic <uint64_t> total_{0};
+};
+
+// Hot-path hooks. Without SEARCH_SERVER_METRICS they expand to nothing, arguments are not even evaluated.
+#ifdef SEARCH_SERVER_METRICS
+#define METRICS_CONCAT_INTERNAL(X, Y) X ## Y
+#define METRICS_CONCAT(X, Y) METRICS_CONCAT_INTERNAL(X, Y)
+#define METRICS_SCOPED_TIMER(histogram) ScopedMetricsTimer METRICS_CONCAT(metrics_timer_, __LINE__)(histogram)
+#define METRICS_ACCUMULATED_TIMER(name, histogram) AccumulatedMetricsTimer name(histogram)
+#define METRICS_LAP(name) AccumulatedMetricsTimer::Lap METRICS_CONCAT(metrics_lap_, __LINE__)(name)
+#define METRICS_ADD(counter, value) MetricsRegistry::Instance().Add((counter), (value))
+#define METRICS_RECORD(histogram, value) MetricsRegistry::Instance().Record((histogram), (value))
+#else
+#define METRICS_SCOPED_TIMER(histogram) static_cast <void> (0)
+#define METRICS_ACCUMULATED_TIMER(name, histogram) static_cast <void> (0)
+#define METRICS_LAP(name) static_cast <void> (0)
+#define METRICS_ADD(counter, value) static_cast <void> (0)
+#define METRICS_RECORD(histogram, value) static_cast <void> (0)
+#endif
@@ -1,27 +1,42 @@
 #pragma once
 
+#include <algorithm>
+#include <iterator>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
 #include <vector>
 
+using namespace std::string_literals;
+
+// A page is the half-open range [first, second); every element is printed
 template <typename Iterator>
 std::ostream& operator<< (std::ostream& os, std::pair <Iterator, Iterator> iter) {
-    if (iter.second != iter.first) {
-        return os << *iter.first << *iter.second;
-    } else {
-        return os << *iter.first;
+    for (Iterator it = iter.first; it != iter.second; ++it) {
+        os << *it;
     }
+
+    return os;
 }
 
+// Pages of a range, each a pair of iterators into it; the last page holds what is left
 template <typename Iterator>
 class Paginator {
     public:
+        // std::invalid_argument for page_size = 0
         Paginator(Iterator container_begin, Iterator container_end, const size_t page_size) {
-            while(container_begin < container_end) {
-                if (static_cast <size_t> (distance(container_begin, container_end)) < page_size) {
-                    pages_.push_back({container_begin, container_begin});
-                } else {
-                    pages_.push_back({container_begin,  container_begin + page_size - 1});
-                }
-                advance(container_begin, page_size);
+            if (page_size == 0) {
+                throw std::invalid_argument("page size must be positive"s);
+            }
+
+            for (size_t left = static_cast <size_t> (std::distance(container_begin, container_end)); left > 0; ) {
+                const size_t current_size = std::min(page_size, left);
+                const Iterator page_end = std::next(container_begin, current_size);
+
+                pages_.push_back({container_begin, page_end});
+                container_begin = page_end;
+                left -= current_size;
             }
         }
 
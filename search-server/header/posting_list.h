@@ -0,0 +1,247 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+/*
+ * Doc-id-sorted postings of one term: the document id and how many times the term occurs in it.
+ * Postings are stored in blocks of up to BLOCK_SIZE as varint id deltas and varint counts, a few
+ * bytes each. A block header keeps the block's id range and where its bytes start, so a scan can
+ * jump straight to the block that holds a given id instead of decoding everything before it.
+ * A list can also view encoded bytes and headers it does not own, e.g. a mapped snapshot; it
+ * reads them in place and copies them out only when it is first changed.
+ */
+class PostingList {
+    public:
+        static constexpr size_t BLOCK_SIZE = 128;
+
+        struct Posting {
+            int document_id;
+            uint32_t count;
+        };
+
+        // The first posting of a block stores only its count, the id is first_document_id.
+        // 24 bytes on every platform, so snapshots can store the headers as they are.
+        struct Block {
+            int first_document_id;
+            int last_document_id;
+            uint32_t size;
+            alignas(8) uint64_t offset;
+        };
+
+        // Decodes one posting at a time; stays valid until the list is modified
+        class const_iterator {
+            public:
+                using iterator_category = std::input_iterator_tag;
+                using value_type = Posting;
+                using difference_type = std::ptrdiff_t;
+                using pointer = const Posting*;
+                using reference = const Posting&;
+
+                const_iterator() = default;
+
+                reference operator* () const { return current_; }
+                pointer operator-> () const { return &current_; }
+
+                const_iterator& operator++ ();
+                // Moves forward to the first posting with document_id >= the given id; never moves back
+                const_iterator& SkipTo(int64_t document_id);
+
+                bool operator== (const const_iterator& other) const { return block_ == other.block_ && index_in_block_ == other.index_in_block_; }
+                bool operator!= (const const_iterator& other) const { return !(*this == other); }
+
+            private:
+                friend class PostingList;
+
+                const PostingList* postings_ = nullptr;
+                const uint8_t* bytes_ = nullptr;
+                const Block* blocks_ = nullptr;
+                size_t block_count_ = 0;
+                size_t block_ = 0;
+                uint32_t index_in_block_ = 0;
+                size_t position_ = 0;
+                Posting current_ = {};
+
+                const_iterator(const PostingList* postings, size_t block);
+        };
+
+        const_iterator begin() const;
+        const_iterator end() const;
+        // First posting with document_id >= the given id; skips whole blocks by their headers
+        const_iterator LowerBound(int64_t document_id) const;
+
+        size_t size() const;
+        bool empty() const;
+        // Postings of the blocks that overlap [begin_id, end_id): an upper bound of the postings in that range, read off the headers
+        size_t CountBlockPostings(int64_t begin_id, int64_t end_id) const;
+
+        // 0 when the document is not in the list
+        uint32_t GetCount(int document_id) const;
+
+        // The id must be greater than every id in the list
+        void Append(int document_id, uint32_t count);
+        // Any id not in the list yet; only the block it falls into is re-encoded
+        void Insert(int document_id, uint32_t count);
+        bool Erase(int document_id);
+        // Adds sorted postings whose ids are not in the list yet
+        void Merge(const std::vector <Posting>& postings);
+
+        template <typename Predicate>
+        size_t RemoveIf(Predicate predicate);
+
+        std::vector <Posting> Decode() const;
+        void Assign(const std::vector <Posting>& postings);
+
+        const uint8_t* GetByteData() const;
+        size_t GetByteCount() const;
+        const Block* GetBlockData() const;
+        size_t GetBlockCount() const;
+
+        // Reads an encoded list in place, offsets relative to bytes; nothing is copied or decoded.
+        // False when the headers disagree with each other or with size. The memory must outlive
+        // the list, or at least last until the list is first changed.
+        bool View(const uint8_t* bytes, size_t byte_count, const Block* blocks, size_t block_count, size_t size);
+        bool IsView() const;
+
+        // Heap bytes only: a view holds none
+        size_t GetByteSize() const;
+
+    private:
+        std::vector <uint8_t> bytes_;
+        std::vector <Block> blocks_;
+        size_t size_ = 0;
+        // set by View; every change copies the viewed list into bytes_ and blocks_ first
+        const uint8_t* viewed_bytes_ = nullptr;
+        const Block* viewed_blocks_ = nullptr;
+        size_t viewed_byte_count_ = 0;
+        size_t viewed_block_count_ = 0;
+        bool is_view_ = false;
+
+        void Detach();
+
+        size_t FindBlock(int64_t document_id) const;
+        size_t GetBlockEnd(size_t block) const;
+        std::vector <Posting> DecodeBlock(size_t block) const;
+        void ReplaceBlock(size_t block, const std::vector <Posting>& postings);
+
+        static void WriteVarint(std::vector <uint8_t>& bytes, uint32_t value);
+        static uint32_t ReadVarint(const uint8_t* bytes, size_t& position);
+};
+
+inline uint32_t PostingList::ReadVarint(const uint8_t* bytes, size_t& position) {
+    uint32_t value = bytes[position] & 0x7F;
+
+    for (int shift = 7; bytes[position++] & 0x80; shift += 7) {
+        value |= static_cast <uint32_t> (bytes[position] & 0x7F) << shift;
+    }
+
+    return value;
+}
+
+inline PostingList::const_iterator::const_iterator(const PostingList* postings, size_t block)
+    : postings_(postings)
+    , bytes_(postings->GetByteData())
+    , blocks_(postings->GetBlockData())
+    , block_count_(postings->GetBlockCount())
+    , block_(block)
+{
+    if (block_ < block_count_) {
+        const Block& header = blocks_[block_];
+
+        position_ = header.offset;
+        current_.document_id = header.first_document_id;
+        current_.count = ReadVarint(bytes_, position_);
+    }
+}
+
+inline PostingList::const_iterator& PostingList::const_iterator::operator++ () {
+    if (++index_in_block_ == blocks_[block_].size) {
+        *this = const_iterator(postings_, block_ + 1);
+        return *this;
+    }
+
+    current_.document_id += static_cast <int> (ReadVarint(bytes_, position_));
+    current_.count = ReadVarint(bytes_, position_);
+
+    return *this;
+}
+
+inline PostingList::const_iterator& PostingList::const_iterator::SkipTo(int64_t document_id) {
+    if (block_ == block_count_ || current_.document_id >= document_id) {
+        return *this;
+    }
+
+    if (blocks_[block_].last_document_id < document_id) {
+        const Block* const block_iter = std::partition_point(blocks_ + block_ + 1, blocks_ + block_count_, [document_id](const Block& block) {
+            return block.last_document_id < document_id;
+        });
+
+        *this = const_iterator(postings_, block_iter - blocks_);
+    }
+
+    while (block_ < block_count_ && current_.document_id < document_id) {
+        ++*this;
+    }
+
+    return *this;
+}
+
+inline PostingList::const_iterator PostingList::begin() const {
+    return const_iterator(this, 0);
+}
+
+inline PostingList::const_iterator PostingList::end() const {
+    return const_iterator(this, GetBlockCount());
+}
+
+inline PostingList::const_iterator PostingList::LowerBound(int64_t document_id) const {
+    const_iterator iter(this, FindBlock(document_id));
+
+    // the block's last id is not below document_id, so this never leaves the block
+    while (iter.block_ < iter.block_count_ && iter->document_id < document_id) {
+        ++iter;
+    }
+
+    return iter;
+}
+
+inline const uint8_t* PostingList::GetByteData() const {
+    return is_view_ ? viewed_bytes_ : bytes_.data();
+}
+
+inline size_t PostingList::GetByteCount() const {
+    return is_view_ ? viewed_byte_count_ : bytes_.size();
+}
+
+inline const PostingList::Block* PostingList::GetBlockData() const {
+    return is_view_ ? viewed_blocks_ : blocks_.data();
+}
+
+inline size_t PostingList::GetBlockCount() const {
+    return is_view_ ? viewed_block_count_ : blocks_.size();
+}
+
+inline size_t PostingList::FindBlock(int64_t document_id) const {
+    const Block* const blocks = GetBlockData();
+
+    return std::partition_point(blocks, blocks + GetBlockCount(), [document_id](const Block& block) {
+        return block.last_document_id < document_id;
+    }) - blocks;
+}
+
+template <typename Predicate>
+size_t PostingList::RemoveIf(Predicate predicate) {
+    std::vector <Posting> postings = Decode();
+    const auto new_end = std::remove_if(postings.begin(), postings.end(), predicate);
+    const size_t removed_count = postings.end() - new_end;
+
+    if (removed_count > 0) {
+        postings.erase(new_end, postings.end());
+        Assign(postings);
+    }
+
+    return removed_count;
+}
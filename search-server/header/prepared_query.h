@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class SearchServer;
+
+/*
+ * A query parsed and validated once by SearchServer::Prepare, for running many times. It owns its
+ * words (sorted, unique, stop words dropped) and caches their term ids and the plus words' IDFs as
+ * of one state of one server. Running it there skips parsing and dictionary lookups. On another
+ * server with the same stop words, or after the index has changed, the words are looked up again on
+ * every run; preparing the query again caches the new state. Safe to run from several threads at once.
+ */
+class PreparedQuery {
+    public:
+        PreparedQuery() = default;
+
+        const std::vector <std::string>& GetPlusWords() const {
+            return plus_words_;
+        }
+
+        const std::vector <std::string>& GetMinusWords() const {
+            return minus_words_;
+        }
+
+    private:
+        friend class SearchServer;
+
+        std::vector <std::string> plus_words_;
+        std::vector <std::string> minus_words_;
+        // SearchServer::index_version_ the rest was resolved at; 0 resolves nothing
+        uint64_t index_version_ = 0;
+        // in word order; TermDictionary::NO_TERM for a word the index does not have
+        std::vector <uint32_t> plus_term_ids_;
+        std::vector <uint32_t> minus_term_ids_;
+        std::vector <double> inverse_document_freqs_;
+};
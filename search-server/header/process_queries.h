@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <iterator>
+
+#include "search_server.h"
+#include "document.h"
+
+// Flat view over per-query results; documents are handed out one by one without copying the batch
+class JoinedDocuments {
+    public:
+        class Iterator {
+            public:
+                using iterator_category = std::forward_iterator_tag;
+                using value_type = Document;
+                using difference_type = std::ptrdiff_t;
+                using pointer = const Document*;
+                using reference = const Document&;
+
+                Iterator() = default;
+                Iterator(const std::vector <std::vector <Document>>* results, size_t query_index, size_t document_index);
+
+                reference operator* () const;
+                pointer operator-> () const;
+
+                Iterator& operator++ ();
+                Iterator operator++ (int);
+
+                bool operator== (const Iterator& other) const;
+                bool operator!= (const Iterator& other) const;
+
+            private:
+                const std::vector <std::vector <Document>>* results_ = nullptr;
+                size_t query_index_ = 0;
+                size_t document_index_ = 0;
+
+                void SkipEmptyQueries();
+        };
+
+        explicit JoinedDocuments(std::vector <std::vector <Document>> results);
+
+        Iterator begin() const;
+        Iterator end() const;
+
+        size_t size() const;
+        bool empty() const;
+
+    private:
+        std::vector <std::vector <Document>> results_;
+        size_t size_ = 0;
+};
+
+std::vector <std::vector <Document>> ProcessQueries(const SearchServer& search_server, const std::vector <std::string>& queries);
+
+JoinedDocuments ProcessQueriesJoined(const SearchServer& search_server, const std::vector <std::string>& queries);
@@ -1,5 +1,17 @@
 #pragma once
 
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
 #include "search_server.h"
 
-void RemoveDuplicates(SearchServer& search_server);
+// Hash of a sorted word set. Documents are grouped by it and compared exactly inside a group,
+// so any function that gives equal sets equal hashes is correct; a weak one is only slower.
+using WordSetFingerprint = uint64_t (*)(const std::vector <std::string_view>& words);
+
+uint64_t ComputeWordSetFingerprint(const std::vector <std::string_view>& words);
+
+// Removes every document whose set of words repeats a document with a smaller id.
+// Returns the removed ids in ascending order.
+std::vector <int> RemoveDuplicates(SearchServer& search_server, WordSetFingerprint fingerprint = ComputeWordSetFingerprint);
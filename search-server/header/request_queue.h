@@ -2,42 +2,157 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <deque>
+#include <list>
+#include <unordered_map>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 
 #include "search_server.h"
 #include "document.h"
+#include "thread_pool.h"
 
+// Worker threads behind AddFindRequestAsync, started on the first async request
+struct AsyncOptions {
+    // 0 takes one thread per core
+    size_t thread_count = 0;
+    // requests waiting for a thread; one more is turned away
+    size_t queue_capacity = 1024;
+};
+
+/*
+ * Every method may be called from several threads at once, as long as nobody changes the
+ * server meanwhile. The statistics cover the last 1440 requests that completed.
+ */
 class RequestQueue {
     public:
-        explicit RequestQueue(const SearchServer &search_server);
+        struct CacheStats {
+            size_t hits = 0;
+            size_t misses = 0;
+            size_t evictions = 0;
+        };
+
+        // Latencies run from the call (or the submission, for async requests) to the result, in microseconds
+        struct RequestStats {
+            size_t request_count = 0;
+            size_t no_result_count = 0;
+            double p50_us = 0.0;
+            double p90_us = 0.0;
+            double p99_us = 0.0;
+            double max_us = 0.0;
+            // async requests turned away by a full queue, since the start
+            size_t rejected_count = 0;
+        };
+
+        // cache_capacity = 0 keeps the queue uncached
+        explicit RequestQueue(const SearchServer &search_server, size_t cache_capacity = 0, const AsyncOptions& async_options = {});
 
         template <typename DocumentPredicate>
-        std::vector <Document> AddFindRequest(const std::string &raw_query, DocumentPredicate document_predicate);
+        std::vector <Document> AddFindRequest(std::string_view raw_query, DocumentPredicate document_predicate);
 
-        std::vector <Document> AddFindRequest(const std::string &raw_query, DocumentStatus status);
-        std::vector <Document> AddFindRequest(const std::string &raw_query);
+        std::vector <Document> AddFindRequest(std::string_view raw_query, DocumentStatus status);
+        std::vector <Document> AddFindRequest(std::string_view raw_query);
 
-        void ChangeStateDeque(const std::vector <Document> &matched_documents);
+        // Run on the pool; an invalid query surfaces from future::get.
+        // std::runtime_error when the pool's queue is full: the request is not run.
+        template <typename DocumentPredicate>
+        std::future <std::vector <Document>> AddFindRequestAsync(std::string raw_query, DocumentPredicate document_predicate);
+
+        std::future <std::vector <Document>> AddFindRequestAsync(std::string raw_query, DocumentStatus status);
+        std::future <std::vector <Document>> AddFindRequestAsync(std::string raw_query);
+
+        void ChangeStateDeque(const std::vector <Document> &matched_documents, double latency_us = 0.0);
 
         int GetNoResultRequests() const;
 
+        RequestStats GetRequestStats() const;
+        CacheStats GetCacheStats() const;
+
     private:
         struct QueryResult {
             bool isEmpty;
+            double latency_us;
+        };
+
+        struct CacheEntry {
+            std::string key;
+            uint64_t modification_count;
+            std::vector <Document> documents;
         };
 
         //DATA
+        mutable std::mutex requests_mutex_;
         std::deque <QueryResult> requests_;
         const static int min_in_day_ = 1440;
         const SearchServer& search_server_;
         int empty_counter_;
+        size_t rejected_counter_ = 0;
+
+        // least recently used entry at the back
+        const size_t cache_capacity_;
+        mutable std::mutex cache_mutex_;
+        std::list <CacheEntry> cache_;
+        std::unordered_map <std::string_view, std::list <CacheEntry>::iterator> cache_index_;
+        CacheStats cache_stats_;
+
+        const AsyncOptions async_options_;
+        std::once_flag pool_started_;
+        // last, so it is destroyed first: the requests still waiting finish while the rest is alive
+        std::unique_ptr <ThreadPool> pool_;
+
+        std::vector <Document> FindCached(std::string_view raw_query, DocumentStatus status);
+
+        template <typename Find>
+        std::future <std::vector <Document>> Submit(Find find);
 };
 
+// Arbitrary predicates cannot be part of a cache key, so these requests always go to the server
 template <typename DocumentPredicate>
-std::vector <Document> RequestQueue::AddFindRequest(const std::string &raw_query, DocumentPredicate document_predicate) {
+std::vector <Document> RequestQueue::AddFindRequest(std::string_view raw_query, DocumentPredicate document_predicate) {
+    const auto start = std::chrono::steady_clock::now();
     std::vector <Document> matched_documents = search_server_.FindTopDocuments(raw_query, document_predicate);
 
-    ChangeStateDeque(matched_documents);
+    ChangeStateDeque(matched_documents, std::chrono::duration <double, std::micro> (std::chrono::steady_clock::now() - start).count());
 
     return matched_documents;
-}
\ No newline at end of file
+}
+
+template <typename DocumentPredicate>
+std::future <std::vector <Document>> RequestQueue::AddFindRequestAsync(std::string raw_query, DocumentPredicate document_predicate) {
+    return Submit([this, raw_query = std::move(raw_query), document_predicate]() {
+        return search_server_.FindTopDocuments(raw_query, document_predicate);
+    });
+}
+
+// The latency includes the wait in the pool's queue
+template <typename Find>
+std::future <std::vector <Document>> RequestQueue::Submit(Find find) {
+    std::call_once(pool_started_, [this]() {
+        pool_ = std::make_unique <ThreadPool> (async_options_.thread_count, async_options_.queue_capacity);
+    });
+
+    const auto start = std::chrono::steady_clock::now();
+    auto task = std::make_shared <std::packaged_task <std::vector <Document>()>> ([this, find = std::move(find), start]() {
+        std::vector <Document> matched_documents = find();
+
+        ChangeStateDeque(matched_documents, std::chrono::duration <double, std::micro> (std::chrono::steady_clock::now() - start).count());
+
+        return matched_documents;
+    });
+    std::future <std::vector <Document>> result = task->get_future();
+
+    if (!pool_->TrySubmit([task]() { (*task)(); })) {
+        {
+            std::lock_guard <std::mutex> guard(requests_mutex_);
+            ++rejected_counter_;
+        }
+
+        throw std::runtime_error("request queue is full"s);
+    }
+
+    return result;
+}
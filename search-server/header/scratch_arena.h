@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+/*
+ * Per-thread bump allocator for memory that only lives through one call: parsed query words,
+ * score accumulators, a document's word counts. A Scope marks the arena when it opens and
+ * rewinds to the mark when it closes, so nested calls stack and nothing is freed one by one.
+ * When the outermost scope closes after the arena had to grow, its blocks are merged into one
+ * big enough for all of them: a steady workload stops allocating once it has warmed up.
+ * Whatever is allocated inside a scope must not outlive it.
+ */
+class ScratchArena : public std::pmr::memory_resource {
+    public:
+        class Scope {
+            public:
+                Scope();
+                ~Scope();
+
+                Scope(const Scope&) = delete;
+                Scope& operator= (const Scope&) = delete;
+
+                std::pmr::memory_resource* GetResource() const;
+
+            private:
+                ScratchArena& arena_;
+                size_t block_;
+                size_t offset_;
+        };
+
+        static constexpr size_t MIN_BLOCK_SIZE = 4096;
+
+        ScratchArena() = default;
+        ScratchArena(const ScratchArena&) = delete;
+        ScratchArena& operator= (const ScratchArena&) = delete;
+
+        // The calling thread's arena
+        static ScratchArena& ForThisThread();
+
+        size_t GetCapacity() const;
+        // Blocks taken from the heap so far; stays put once the workload has warmed up
+        uint64_t GetBlockAllocationCount() const;
+
+    private:
+        struct Block {
+            std::unique_ptr <std::byte[]> data;
+            size_t size = 0;
+        };
+
+        std::vector <Block> blocks_;
+        size_t block_ = 0;
+        size_t offset_ = 0;
+        size_t scope_depth_ = 0;
+        uint64_t block_allocation_count_ = 0;
+
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        // released all at once when the scope closes
+        void do_deallocate(void*, size_t, size_t) override {}
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+        void AddBlock(size_t size);
+        void MergeBlocks();
+};
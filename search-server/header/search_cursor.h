@@ -0,0 +1,192 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+#include "prepared_query.h"
+#include "search_server.h"
+
+/*
+ * Lazy paging over one query's results in ranking order. The query is prepared once, and again
+ * after the server changes. A refill asks the server only for the documents after the last one
+ * handed out (SearchOptions::search_after): twice as many as the previous refill, up to
+ * MAX_PREFETCH_PAGES pages, and keeps the ones not handed out yet for the next pages. Page n thus
+ * costs about log n pruned evaluations with a heap of a few pages, instead of ranking every earlier
+ * page again. A skip goes the same way, at most MAX_PREFETCH_PAGES pages per evaluation, so the heap
+ * stays small however far it jumps. When the server changes, the kept documents are dropped and paging goes on after the
+ * last document handed out, ranked by the changed index.
+ * The server must outlive the cursor and must not change while a page is being fetched.
+ */
+template <typename KeyMapper>
+class SearchCursor {
+    public:
+        static constexpr size_t MAX_PREFETCH_PAGES = 64;
+
+        // std::invalid_argument for page_size = 0 or a query with control characters
+        SearchCursor(const SearchServer& search_server, std::string_view raw_query, KeyMapper k_mapper, size_t page_size);
+
+        // The next page_size documents at most; empty once the results are exhausted
+        std::vector <Document> NextPage();
+        // Passes over document_count documents, e.g. to open at a later page; passing the end exhausts the cursor
+        void Skip(size_t document_count);
+        // Search-after: the next page starts right after this document, wherever it came from
+        void SeekAfter(const Document& document);
+
+        // The last document handed out or skipped
+        const std::optional <Document>& GetPosition() const;
+        size_t GetPageSize() const;
+        // true once a page or a skip came back short
+        bool IsExhausted() const;
+
+    private:
+        const SearchServer& search_server_;
+        std::string raw_query_;
+        PreparedQuery query_;
+        KeyMapper k_mapper_;
+        size_t page_size_;
+        size_t prefetch_pages_ = 1;
+        std::optional <Document> position_;
+        // fetched and not handed out yet: buffer_[buffer_offset_...], in ranking order
+        std::vector <Document> buffer_;
+        size_t buffer_offset_ = 0;
+        uint64_t modification_count_ = 0;
+        // the last refill came back short, so nothing is left after buffer_
+        bool is_complete_ = false;
+        bool is_exhausted_ = false;
+
+        // Moves the position over up to document_count documents, appending them to output if given
+        size_t Advance(size_t document_count, std::vector <Document>* output);
+        void Refill(size_t min_count);
+};
+
+template <typename KeyMapper>
+SearchCursor <KeyMapper>::SearchCursor(const SearchServer& search_server, std::string_view raw_query, KeyMapper k_mapper, size_t page_size)
+    : search_server_(search_server)
+    , raw_query_(raw_query)
+    , query_(search_server.Prepare(raw_query))
+    , k_mapper_(k_mapper)
+    , page_size_(page_size)
+    , modification_count_(search_server.GetModificationCount())
+{
+    if (page_size == 0) {
+        throw std::invalid_argument("page size must be positive"s);
+    }
+}
+
+template <typename KeyMapper>
+std::vector <Document> SearchCursor <KeyMapper>::NextPage() {
+    std::vector <Document> page;
+
+    if (Advance(page_size_, &page) < page_size_) {
+        is_exhausted_ = true;
+    }
+
+    return page;
+}
+
+template <typename KeyMapper>
+void SearchCursor <KeyMapper>::Skip(size_t document_count) {
+    if (Advance(document_count, nullptr) < document_count) {
+        is_exhausted_ = true;
+    }
+}
+
+template <typename KeyMapper>
+void SearchCursor <KeyMapper>::SeekAfter(const Document& document) {
+    position_ = document;
+    buffer_.clear();
+    buffer_offset_ = 0;
+    prefetch_pages_ = 1;
+    is_complete_ = false;
+    is_exhausted_ = false;
+}
+
+template <typename KeyMapper>
+const std::optional <Document>& SearchCursor <KeyMapper>::GetPosition() const {
+    return position_;
+}
+
+template <typename KeyMapper>
+size_t SearchCursor <KeyMapper>::GetPageSize() const {
+    return page_size_;
+}
+
+template <typename KeyMapper>
+bool SearchCursor <KeyMapper>::IsExhausted() const {
+    return is_exhausted_;
+}
+
+template <typename KeyMapper>
+size_t SearchCursor <KeyMapper>::Advance(size_t document_count, std::vector <Document>* output) {
+    if (search_server_.GetModificationCount() != modification_count_) {
+        query_ = search_server_.Prepare(raw_query_);
+        modification_count_ = search_server_.GetModificationCount();
+        buffer_.clear();
+        buffer_offset_ = 0;
+        is_complete_ = false;
+    }
+
+    size_t advanced = 0;
+
+    while (advanced < document_count) {
+        if (buffer_offset_ == buffer_.size()) {
+            if (is_complete_) {
+                break;
+            }
+
+            Refill(document_count - advanced);
+
+            if (buffer_.empty()) {
+                break;
+            }
+        }
+
+        const size_t taken = std::min(document_count - advanced, buffer_.size() - buffer_offset_);
+        const auto first = buffer_.begin() + buffer_offset_;
+
+        if (output != nullptr) {
+            output->insert(output->end(), first, first + taken);
+        }
+
+        buffer_offset_ += taken;
+        advanced += taken;
+        position_ = buffer_[buffer_offset_ - 1];
+    }
+
+    return advanced;
+}
+
+template <typename KeyMapper>
+void SearchCursor <KeyMapper>::Refill(size_t min_count) {
+    auto get_document_count = [this](size_t page_count) {
+        return page_size_ > SIZE_MAX / page_count ? SIZE_MAX : page_size_ * page_count;
+    };
+
+    SearchOptions options;
+    options.max_result_count = std::clamp(min_count, get_document_count(prefetch_pages_), get_document_count(MAX_PREFETCH_PAGES));
+    options.search_after = position_;
+
+    prefetch_pages_ = std::min(prefetch_pages_ * 2, MAX_PREFETCH_PAGES);
+    buffer_ = search_server_.FindTopDocuments(query_, k_mapper_, options);
+    buffer_offset_ = 0;
+    is_complete_ = buffer_.size() < options.max_result_count;
+}
+
+template <typename KeyMapper>
+SearchCursor <KeyMapper> OpenCursor(const SearchServer& search_server, std::string_view raw_query, KeyMapper k_mapper, size_t page_size) {
+    return SearchCursor <KeyMapper> (search_server, raw_query, k_mapper, page_size);
+}
+
+inline SearchCursor <SearchServer::StatusFilter> OpenCursor(const SearchServer& search_server, std::string_view raw_query, DocumentStatus status, size_t page_size) {
+    return SearchCursor <SearchServer::StatusFilter> (search_server, raw_query, SearchServer::StatusFilter{status}, page_size);
+}
+
+inline SearchCursor <SearchServer::StatusFilter> OpenCursor(const SearchServer& search_server, std::string_view raw_query, size_t page_size) {
+    return OpenCursor(search_server, raw_query, DocumentStatus::ACTUAL, page_size);
+}
@@ -3,82 +3,297 @@
 #include <vector>
 #include <set>
 #include <string>
+#include <string_view>
+#include <tuple>
 #include <algorithm>
 #include <cmath>
 #include <map>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
 #include <utility>
 #include <numeric>
 #include <stdexcept>
+#include <execution>
+#include <thread>
+#include <type_traits>
 
 #include "document.h"
+#include "document_table.h"
+#include "mapped_file.h"
+#include "metrics.h"
+#include "posting_list.h"
+#include "prepared_query.h"
 #include "read_input_functions.h"
+#include "scratch_arena.h"
 #include "string_processing.h"
+#include "term_dictionary.h"
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 constexpr double ACCURACY = 1e-6;
 
+struct SearchOptions {
+    size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT;
+    // Sequential evaluation skips documents that cannot reach the top (MaxScore); results are the same either way
+    bool pruning = true;
+    // Search-after: only documents ranked strictly after this one, e.g. the last of the previous page
+    std::optional <Document> search_after;
+};
+
+struct CompactionStats {
+    size_t removed_postings = 0;
+    size_t removed_terms = 0;
+    size_t bytes_reclaimed = 0;
+};
+
+// Ranking order of the results: relevance, then rating when relevances are within ACCURACY, then id
+struct MoreRelevant {
+    bool operator() (const Document& lhs, const Document& rhs) const {
+        if (std::abs(lhs.relevance - rhs.relevance) < ACCURACY) {
+            return lhs.rating == rhs.rating ? lhs.id < rhs.id : lhs.rating > rhs.rating;
+        }
+
+        return lhs.relevance > rhs.relevance;
+    }
+};
+
 class SearchServer {
     public:
         template <typename StringCollection>
         explicit SearchServer(const StringCollection& stop_words);
         explicit SearchServer(const std::string& text);
+        explicit SearchServer(std::string_view text);
+
+        // Words are stored once in the dictionary and viewed from everywhere else, so a copy would dangle
+        SearchServer(const SearchServer&) = delete;
+        SearchServer& operator= (const SearchServer&) = delete;
+        SearchServer(SearchServer&&) = default;
+        SearchServer& operator= (SearchServer&&) = default;
+
+        // Versioned, checksummed binary image of the whole index; see snapshot.h for the layout
+        void SaveSnapshot(const std::string& path) const;
+        static SearchServer LoadSnapshot(const std::string& path);
 
-        void AddDocument(int document_id, const std::string& document, DocumentStatus status, const std::vector <int>& ratings);
+        void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector <int>& ratings);
+
+        // Tokenizes the batch on all cores into per-worker partial indexes and merges them in one pass.
+        // Rejected documents are skipped and reported in batch order; the rest of the batch is added.
+        std::vector <DocumentError> AddDocuments(const std::vector <DocumentRecord>& documents);
+        // Removal only tombstones the document: its postings stay in place, are skipped by scoring
+        // and are dropped by the next Compact. Unknown ids are ignored.
         void RemoveDocument(int document_id);
+        void RemoveDocuments(const std::vector <int>& document_ids);
+
+        // Rewrites the posting lists without tombstoned documents and drops terms no document uses.
+        // Results do not change. When terms are dropped, word views obtained earlier are invalidated.
+        CompactionStats Compact();
+
+        // Postings of removed documents still waiting for Compact
+        size_t GetRemovedPostingCount() const;
 
         template <typename KeyMapper>
-        std::vector <Document> FindTopDocuments(const std::string& raw_query, KeyMapper k_mapper) const;
-        std::vector <Document> FindTopDocuments(const std::string& raw_query, DocumentStatus status) const;
-        std::vector <Document> FindTopDocuments(const std::string& raw_query) const;
+        std::vector <Document> FindTopDocuments(std::string_view raw_query, KeyMapper k_mapper, const SearchOptions& options = {}) const;
+        std::vector <Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status, const SearchOptions& options = {}) const;
+        std::vector <Document> FindTopDocuments(std::string_view raw_query, const SearchOptions& options = {}) const;
+
+        template <typename ExecutionPolicy, typename KeyMapper>
+        std::vector <Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, KeyMapper k_mapper, const SearchOptions& options = {}) const;
+        template <typename ExecutionPolicy>
+        std::vector <Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status, const SearchOptions& options = {}) const;
+        template <typename ExecutionPolicy>
+        std::vector <Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, const SearchOptions& options = {}) const;
+
+        // Parses and validates the query once and resolves its words against the current index
+        PreparedQuery Prepare(std::string_view raw_query) const;
+
+        template <typename KeyMapper>
+        std::vector <Document> FindTopDocuments(const PreparedQuery& query, KeyMapper k_mapper, const SearchOptions& options = {}) const;
+        std::vector <Document> FindTopDocuments(const PreparedQuery& query, DocumentStatus status, const SearchOptions& options = {}) const;
+        std::vector <Document> FindTopDocuments(const PreparedQuery& query, const SearchOptions& options = {}) const;
+
+        template <typename ExecutionPolicy, typename KeyMapper>
+        std::vector <Document> FindTopDocuments(ExecutionPolicy&& policy, const PreparedQuery& query, KeyMapper k_mapper, const SearchOptions& options = {}) const;
+        template <typename ExecutionPolicy>
+        std::vector <Document> FindTopDocuments(ExecutionPolicy&& policy, const PreparedQuery& query, DocumentStatus status, const SearchOptions& options = {}) const;
+        template <typename ExecutionPolicy>
+        std::vector <Document> FindTopDocuments(ExecutionPolicy&& policy, const PreparedQuery& query, const SearchOptions& options = {}) const;
 
         int GetDocumentCount() const;
 
-        const std::map <std::string, double>& GetWordFrequencies(int document_id) const;
+        // Grows on every AddDocument/RemoveDocument (not on Compact); results computed at an older value may be stale
+        uint64_t GetModificationCount() const;
 
-        std::set <int> ::const_iterator begin();
-        std::set <int> ::const_iterator end();
+        // Built from the posting lists on every call: term frequency is the word's count over the document's length
+        std::map <std::string_view, double> GetWordFrequencies(int document_id) const;
+        // The document's distinct words in sorted order, viewing the server's copy of each word
+        std::vector <std::string_view> GetDocumentWords(int document_id) const;
 
-        std::tuple <std::vector <std::string>, DocumentStatus> MatchDocument(const std::string& raw_query, int document_id) const;
+        // Approximate heap bytes held by the index: posting lists, dictionary, per-document records
+        size_t GetIndexByteSize() const;
 
-    private:
-        struct DocumentData {
-            int rating = 0;
+        // Live ids in ascending order
+        DocumentTable::LiveIdIterator begin();
+        DocumentTable::LiveIdIterator end();
+
+        // Matched plus words in sorted order, viewing the server's copy of each word; empty when a minus word matches
+        std::tuple <std::vector <std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+        std::tuple <std::vector <std::string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy&, std::string_view raw_query, int document_id) const;
+        std::tuple <std::vector <std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy&, std::string_view raw_query, int document_id) const;
+        std::tuple <std::vector <std::string_view>, DocumentStatus> MatchDocument(const PreparedQuery& query, int document_id) const;
+        std::tuple <std::vector <std::string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy&, const PreparedQuery& query, int document_id) const;
+        std::tuple <std::vector <std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy&, const PreparedQuery& query, int document_id) const;
+
+        // Equivalent queries map to the same string: sorted unique plus words, then sorted unique "-minus" words, no stop words
+        std::string NormalizeQuery(std::string_view raw_query) const;
+
+        // KeyMapper of the status overloads; scoring tests the table's status bit instead of calling it
+        struct StatusFilter {
             DocumentStatus status;
+
+            bool operator() (int, DocumentStatus document_status, int) const {
+                return document_status == status;
+            }
+        };
+
+    private:
+        // scores its shards against corpus-wide document frequencies
+        friend class ShardedSearchServer;
+        // tokenizes a batch on its own thread while the previous batch is merged
+        friend class DocumentLoader;
+
+        // Postings and forward lists of one worker's share of a batch, keyed by worker-local term ids.
+        // Postings name documents by batch position until the merge decides which of them are accepted.
+        struct PartialIndex {
+            struct LocalPosting {
+                size_t index;
+                uint32_t count;
+                uint32_t word_count;
+            };
+
+            struct IndexedDocument {
+                size_t index;
+                uint32_t word_count;
+                std::vector <uint32_t> term_ids;
+            };
+
+            std::unordered_map <std::string_view, uint32_t> term_ids;
+            std::vector <std::string_view> words;
+            std::vector <std::vector <LocalPosting>> postings;
+            std::vector <IndexedDocument> documents;
+            std::vector <size_t> invalid_documents;
+        };
+
+        // A plus term's read position in its postings during pruned evaluation
+        struct ScoreCursor {
+            PostingList::const_iterator iter;
+            PostingList::const_iterator end;
+            double inverse_document_freq;
+            // the most one posting can add: the term's highest TF times its IDF
+            double max_score;
+            size_t word_index;
         };
 
         struct QueryWord {
-            std::string data;
+            std::string_view data;
             bool is_minus = false;
             bool is_stop = false;
         };
 
+        // sorted and deduplicated; views point into the raw query or a PreparedQuery, the vectors usually into a ScratchArena
         struct Query {
-            std::set <std::string> plus_words;
-            std::set <std::string> minus_words;
+            std::pmr::vector <std::string_view> plus_words;
+            std::pmr::vector <std::string_view> minus_words;
+            // the words' term ids in this index, from a PreparedQuery resolved against it; looked up by word otherwise
+            const std::vector <uint32_t>* plus_term_ids = nullptr;
+            const std::vector <uint32_t>* minus_term_ids = nullptr;
         };
 
+        SearchServer() = default;
+
         /**--- DATA ---**/
-        std::set <std::string> stop_words_;
-        std::map <std::string, std::map <int, double>> word_to_document_freqs_;
-        std::map <int, DocumentData> documents_;
-        std::set <int> id_base_;
-        std::map <int, std::map <std::string, double>> word_freqs_ids_;
+        // the snapshot the index was loaded from, if any: unchanged posting lists, the loaded words and forward lists view it
+        std::unique_ptr <const MappedFile> snapshot_file_;
+        std::set <std::string, std::less <>> stop_words_;
+        TermDictionary terms_;
+        std::vector <PostingList> postings_;
+        std::vector <uint32_t> document_freqs_;
+        std::vector <double> log_document_freqs_;
+        // highest TF any posting of the term has had; removals leave it as an upper bound
+        std::vector <double> max_term_freqs_;
+        double log_document_count_ = 0.0;
+        uint64_t modification_count_ = 0;
+        // unique over all servers and redrawn by every change to term ids or IDFs, Compact included
+        uint64_t index_version_ = NextIndexVersion();
+        // a document's word count is the words left after the stop words; its term ids are distinct and in word order.
+        // A tombstoned document keeps its row, terms included, until its postings are dropped.
+        DocumentTable documents_;
+        size_t removed_posting_count_ = 0;
         /**------------**/
 
-        bool IsStopWord(const std::string& word) const;
+        static uint64_t NextIndexVersion();
+        void MarkModified();
+
+        bool IsStopWord(std::string_view word) const;
 
-        static bool IsValidWord(const std::string& word);
+        static bool IsValidWord(std::string_view word);
         static int ComputeAverageRating(const std::vector <int>& ratings);
 
-        double ComputeWordInverseDocumentFreq(const std::string& word) const;
+        static double ComputeTermFreq(uint32_t count, uint32_t word_count);
+        double ComputeWordInverseDocumentFreq(uint32_t term_id) const;
+        uint32_t GetDocumentFreq(std::string_view word) const;
+
+        bool IsRemoved(int document_id) const;
+        void MarkRemoved(uint32_t ordinal);
+        void PurgeRemovedDocument(int document_id);
+
+        const PostingList* FindPostings(std::string_view word) const;
+        uint32_t FindPlusTerm(const Query& query, size_t word_index) const;
+        const PostingList* FindMinusPostings(const Query& query, size_t word_index) const;
+        // The live document's ordinal; std::out_of_range for an unknown id
+        uint32_t FindMatchedDocument(int document_id) const;
+        std::string_view FindDocumentWord(uint32_t ordinal, std::string_view word) const;
+
+        // AddDocuments in two steps. Preparing reads nothing but the stop words, so it may run on
+        // another thread while a commit changes the index; the commit makes every accept decision.
+        std::vector <PartialIndex> PrepareDocuments(const std::vector <DocumentRecord>& documents, const std::vector <size_t>& candidates) const;
+        std::vector <DocumentError> CommitDocuments(const std::vector <DocumentRecord>& documents, std::vector <PartialIndex>& partial_indexes);
+        void BuildPartialIndex(const std::vector <DocumentRecord>& documents, const std::vector <size_t>& indexes, PartialIndex& partial_index) const;
 
-        std::vector <std::string> SplitIntoWordsNoStop(const std::string& text) const;
+        TokenizedText TokenizeNoStop(std::string_view text, std::pmr::memory_resource* resource) const;
 
-        QueryWord ParseQueryWord(const std::string& text) const;
-        Query ParseQuery(const std::string& text) const;
+        QueryWord ParseQueryWord(std::string_view text) const;
+        Query ParseQuery(std::string_view text, std::pmr::memory_resource* resource) const;
+        // Views of the prepared words, with its term ids when they were resolved against this index's current version
+        Query ViewQuery(const PreparedQuery& prepared_query, std::pmr::memory_resource* resource) const;
+        // The prepared IDFs when they are current here, nullptr otherwise
+        const std::vector <double>* GetPreparedInverseDocumentFreqs(const PreparedQuery& prepared_query) const;
 
+        std::tuple <std::vector <std::string_view>, DocumentStatus> MatchQuery(const std::execution::sequenced_policy&, const Query& query, int document_id) const;
+        std::tuple <std::vector <std::string_view>, DocumentStatus> MatchQuery(const std::execution::parallel_policy&, const Query& query, int document_id) const;
+
+        // The document's ordinal when it is live and k_mapper accepts it, NO_ORDINAL otherwise
+        template <typename KeyMapper>
+        uint32_t FindAcceptedDocument(KeyMapper& k_mapper, int document_id) const;
+
+        // document_to_relevance: any map from document id to relevance, walked in id order
+        template <typename DocumentToRelevance>
+        std::vector <Document> SelectTopDocuments(const DocumentToRelevance& document_to_relevance, const SearchOptions& options) const;
+        // One step of SelectTopDocuments' bounded heap; false when the heap is left as it was
+        static bool OfferTopDocument(std::vector <Document>& top_documents, const Document& document, size_t max_count);
+        // Whether the document may be offered at all under options.search_after
+        static bool IsAfter(const SearchOptions& options, const Document& document);
+
+        // inverse_document_freqs, when given, replaces the local IDF of every plus word (same order as query.plus_words)
         template <typename KeyMapper>
-        std::vector <Document> FindAllDocuments(const Query& query, KeyMapper& k_mapper) const;
+        std::vector <Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, KeyMapper& k_mapper, const SearchOptions& options,
+            const std::vector <double>* inverse_document_freqs = nullptr) const;
+        template <typename KeyMapper>
+        std::vector <Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query, KeyMapper& k_mapper, const SearchOptions& options,
+            const std::vector <double>* inverse_document_freqs = nullptr) const;
+        template <typename KeyMapper>
+        std::vector <Document> FindTopDocumentsMaxScore(const Query& query, KeyMapper& k_mapper, const SearchOptions& options, const std::vector <double>* inverse_document_freqs) const;
 };
 
 template <typename StringCollection>
@@ -94,64 +309,522 @@ SearchServer::SearchServer(const StringCollection& stop_words) {
     }
 }
 
+// Defined here so the scoring loops below inline it
+inline double SearchServer::ComputeTermFreq(uint32_t count, uint32_t word_count) {
+    return static_cast <double> (count) / word_count;
+}
+
+inline bool SearchServer::IsAfter(const SearchOptions& options, const Document& document) {
+    return !options.search_after || MoreRelevant()(*options.search_after, document);
+}
+
 template <typename KeyMapper>
-std::vector <Document> SearchServer::FindTopDocuments(const std::string& raw_query, KeyMapper k_mapper) const {
-    for (const std::string& word : SplitIntoWords(raw_query)) {
-        if (!SearchServer::IsValidWord(word)) {
-            throw std::invalid_argument("invalid query word"s);
+std::vector <Document> SearchServer::FindTopDocuments(std::string_view raw_query, KeyMapper k_mapper, const SearchOptions& options) const {
+    return FindTopDocuments(std::execution::seq, raw_query, k_mapper, options);
+}
+
+template <typename ExecutionPolicy, typename KeyMapper>
+std::vector <Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, KeyMapper k_mapper, const SearchOptions& options) const {
+    METRICS_SCOPED_TIMER(MetricHistogram::QUERY_TOTAL);
+    METRICS_ADD(MetricCounter::QUERIES, 1);
+
+    ScratchArena::Scope scratch;
+    const Query query = ParseQuery(raw_query, scratch.GetResource());
+
+    return FindAllDocuments(policy, query, k_mapper, options);
+}
+
+template <typename ExecutionPolicy>
+std::vector <Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status, const SearchOptions& options) const {
+    return FindTopDocuments(policy, raw_query, StatusFilter{status}, options);
+}
+
+template <typename ExecutionPolicy>
+std::vector <Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, const SearchOptions& options) const {
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL, options);
+}
+
+template <typename KeyMapper>
+std::vector <Document> SearchServer::FindTopDocuments(const PreparedQuery& query, KeyMapper k_mapper, const SearchOptions& options) const {
+    return FindTopDocuments(std::execution::seq, query, k_mapper, options);
+}
+
+// No parsing; the term lookups too are skipped when the query was resolved against this index as it is
+template <typename ExecutionPolicy, typename KeyMapper>
+std::vector <Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const PreparedQuery& prepared_query, KeyMapper k_mapper, const SearchOptions& options) const {
+    METRICS_SCOPED_TIMER(MetricHistogram::QUERY_TOTAL);
+    METRICS_ADD(MetricCounter::QUERIES, 1);
+
+    ScratchArena::Scope scratch;
+    const Query query = ViewQuery(prepared_query, scratch.GetResource());
+
+    return FindAllDocuments(policy, query, k_mapper, options, GetPreparedInverseDocumentFreqs(prepared_query));
+}
+
+template <typename ExecutionPolicy>
+std::vector <Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const PreparedQuery& query, DocumentStatus status, const SearchOptions& options) const {
+    return FindTopDocuments(policy, query, StatusFilter{status}, options);
+}
+
+template <typename ExecutionPolicy>
+std::vector <Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const PreparedQuery& query, const SearchOptions& options) const {
+    return FindTopDocuments(policy, query, DocumentStatus::ACTUAL, options);
+}
+
+inline uint32_t SearchServer::FindPlusTerm(const Query& query, size_t word_index) const {
+    return query.plus_term_ids == nullptr ? terms_.Find(query.plus_words[word_index]) : (*query.plus_term_ids)[word_index];
+}
+
+inline const PostingList* SearchServer::FindMinusPostings(const Query& query, size_t word_index) const {
+    if (query.minus_term_ids == nullptr) {
+        return FindPostings(query.minus_words[word_index]);
+    }
+
+    const uint32_t term_id = (*query.minus_term_ids)[word_index];
+    return term_id == TermDictionary::NO_TERM ? nullptr : &postings_[term_id];
+}
+
+template <typename KeyMapper>
+uint32_t SearchServer::FindAcceptedDocument(KeyMapper& k_mapper, int document_id) const {
+    const uint32_t ordinal = documents_.Find(document_id);
+
+    if constexpr (std::is_same_v <std::remove_const_t <KeyMapper>, StatusFilter>) {
+        return documents_.HasStatus(ordinal, k_mapper.status) ? ordinal : DocumentTable::NO_ORDINAL;
+    } else {
+        return documents_.IsLive(ordinal) && k_mapper(document_id, documents_.GetStatus(ordinal), documents_.GetRating(ordinal)) ? ordinal : DocumentTable::NO_ORDINAL;
+    }
+}
+
+// Bounded heap with the weakest of the kept documents on top: the result never grows past max_count
+template <typename DocumentToRelevance>
+std::vector <Document> SearchServer::SelectTopDocuments(const DocumentToRelevance& document_to_relevance, const SearchOptions& options) const {
+    const size_t max_count = options.max_result_count;
+    std::vector <Document> top_documents;
+
+    if (max_count == 0) {
+        return top_documents;
+    }
+
+    top_documents.reserve(std::min(max_count, document_to_relevance.size()));
+
+    for (const auto& [document_id, relevance] : document_to_relevance) {
+        const Document document(document_id, relevance, documents_.GetRating(documents_.Find(document_id)));
+
+        if (IsAfter(options, document)) {
+            OfferTopDocument(top_documents, document, max_count);
         }
     }
 
-    const Query query = ParseQuery(raw_query);
-    std::vector <Document> result = FindAllDocuments(query, k_mapper);
+    std::sort_heap(top_documents.begin(), top_documents.end(), MoreRelevant());
 
-    auto lambda_sort = [](const Document& lhs, const Document& rhs) {
-        return std::abs(lhs.relevance - rhs.relevance) < ACCURACY ? lhs.rating > rhs.rating : lhs.relevance > rhs.relevance;
-    };
+    return top_documents;
+}
+
+template <typename KeyMapper>
+std::vector <Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, KeyMapper& k_mapper, const SearchOptions& options,
+        const std::vector <double>* inverse_document_freqs) const {
+    if (options.pruning) {
+        return FindTopDocumentsMaxScore(query, k_mapper, options, inverse_document_freqs);
+    }
+
+    ScratchArena::Scope scratch;
+    std::pmr::map <int, double> document_to_relevance(scratch.GetResource());
+
+    {
+        METRICS_SCOPED_TIMER(MetricHistogram::QUERY_ACCUMULATION);
+        size_t postings_scanned = 0;
 
-    std::sort(result.begin(), result.end(), lambda_sort);
+        for (size_t word_index = 0; word_index < query.plus_words.size(); ++word_index) {
+            const uint32_t term_id = FindPlusTerm(query, word_index);
 
-    if (result.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        result.resize(MAX_RESULT_DOCUMENT_COUNT);
+            if (term_id == TermDictionary::NO_TERM || document_freqs_[term_id] == 0) {
+                continue;
+            }
+
+            const double inverse_document_freq = inverse_document_freqs == nullptr ? ComputeWordInverseDocumentFreq(term_id) : (*inverse_document_freqs)[word_index];
+            postings_scanned += postings_[term_id].size();
+
+            for (const auto [document_id, count] : postings_[term_id]) {
+                if (const uint32_t ordinal = FindAcceptedDocument(k_mapper, document_id); ordinal != DocumentTable::NO_ORDINAL) {
+                    document_to_relevance[document_id] += ComputeTermFreq(count, documents_.GetWordCount(ordinal)) * inverse_document_freq;
+                }
+            }
+        }
+
+        METRICS_ADD(MetricCounter::POSTINGS_SCANNED, postings_scanned);
+        METRICS_RECORD(MetricHistogram::POSTINGS_PER_QUERY, postings_scanned);
     }
 
-    return result;
+    {
+        METRICS_SCOPED_TIMER(MetricHistogram::QUERY_MINUS_FILTER);
+
+        for (size_t word_index = 0; word_index < query.minus_words.size(); ++word_index) {
+            const PostingList* postings = FindMinusPostings(query, word_index);
+
+            if (postings == nullptr) {
+                continue;
+            }
+
+            for (const auto [document_id, _] : *postings) {
+                document_to_relevance.erase(document_id);
+            }
+        }
+    }
+
+    METRICS_SCOPED_TIMER(MetricHistogram::QUERY_RANKING);
+    METRICS_ADD(MetricCounter::DOCUMENTS_MATCHED, document_to_relevance.size());
+    METRICS_RECORD(MetricHistogram::DOCUMENTS_PER_QUERY, document_to_relevance.size());
+
+    return SelectTopDocuments(document_to_relevance, options);
 }
 
+/*
+ * Every task owns a contiguous range of document ids and merges the plus words' postings of
+ * that range in id order, summing each document's terms in the same order as the sequential
+ * path, so the relevance comes out bit-identical. A task writes its matches into its own slice
+ * of one scratch buffer, sized from the block headers, so the tasks share nothing and the
+ * slices joined in task order are in id order. k_mapper is called from several threads.
+ */
+// Always exhaustive: the tasks have no common heap to prune against
 template <typename KeyMapper>
-std::vector <Document> SearchServer::FindAllDocuments(const Query& query, KeyMapper& k_mapper) const {
-    std::map <int, double> document_to_relevance;
-    std::vector <Document> matched_documents;
+std::vector <Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query, KeyMapper& k_mapper, const SearchOptions& options,
+        const std::vector <double>* inverse_document_freqs) const {
+    if (documents_.GetLiveCount() == 0) {
+        return {};
+    }
 
-    for (const std::string& word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+    ScratchArena::Scope scratch;
+    std::pmr::vector <std::pair <const PostingList*, double>> plus_postings(scratch.GetResource());
+    std::pmr::vector <const PostingList*> minus_postings(scratch.GetResource());
+    std::pmr::vector <std::pair <int, double>> matches(scratch.GetResource());
+
+    {
+        METRICS_SCOPED_TIMER(MetricHistogram::QUERY_ACCUMULATION);
+        size_t postings_scanned = 0;
+
+        for (size_t word_index = 0; word_index < query.plus_words.size(); ++word_index) {
+            const uint32_t term_id = FindPlusTerm(query, word_index);
+
+            if (term_id != TermDictionary::NO_TERM && document_freqs_[term_id] > 0) {
+                const double inverse_document_freq = inverse_document_freqs == nullptr ? ComputeWordInverseDocumentFreq(term_id) : (*inverse_document_freqs)[word_index];
+                plus_postings.push_back({&postings_[term_id], inverse_document_freq});
+                postings_scanned += postings_[term_id].size();
+            }
+        }
+
+        for (size_t word_index = 0; word_index < query.minus_words.size(); ++word_index) {
+            if (const PostingList* postings = FindMinusPostings(query, word_index); postings != nullptr) {
+                minus_postings.push_back(postings);
+            }
         }
 
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
+        const int64_t min_id = documents_.GetMinLiveId();
+        const int64_t id_span = static_cast <int64_t> (documents_.GetMaxLiveId()) - min_id + 1;
+        const int64_t task_count = std::min <int64_t> (id_span, std::max(1u, std::thread::hardware_concurrency()) * 4);
+
+        auto get_range_begin = [min_id, id_span, task_count](int64_t task) {
+            return min_id + id_span * task / task_count;
+        };
+
+        // the matches of task t go to [slice_offsets[t], slice_offsets[t + 1]), match_counts[t] of them
+        std::pmr::vector <size_t> slice_offsets(task_count + 1, 0, scratch.GetResource());
+        std::pmr::vector <size_t> match_counts(task_count, 0, scratch.GetResource());
+        std::pmr::vector <int64_t> tasks(task_count, 0, scratch.GetResource());
+        std::iota(tasks.begin(), tasks.end(), 0);
 
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            if (k_mapper(document_id, documents_.at(document_id).status, documents_.at(document_id).rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+        for (int64_t task = 0; task < task_count; ++task) {
+            size_t slice_size = 0;
+
+            for (const auto& [postings, _] : plus_postings) {
+                slice_size += postings->CountBlockPostings(get_range_begin(task), get_range_begin(task + 1));
             }
+
+            slice_offsets[task + 1] = slice_offsets[task] + slice_size;
         }
+
+        matches.resize(slice_offsets.back());
+
+        // the minus words are probed per candidate inside the tasks
+        METRICS_ACCUMULATED_TIMER(minus_filter_timer, MetricHistogram::QUERY_MINUS_FILTER);
+
+        std::for_each(std::execution::par, tasks.begin(), tasks.end(), [&](const int64_t task) {
+            const int64_t range_begin = get_range_begin(task);
+            const int64_t range_end = get_range_begin(task + 1);
+
+            ScratchArena::Scope task_scratch;
+            std::pmr::vector <std::pair <PostingList::const_iterator, PostingList::const_iterator>> cursors(task_scratch.GetResource());
+            std::pmr::vector <std::pair <PostingList::const_iterator, PostingList::const_iterator>> minus_cursors(task_scratch.GetResource());
+
+            for (const auto& [postings, _] : plus_postings) {
+                cursors.push_back({postings->LowerBound(range_begin), postings->end()});
+            }
+
+            for (const PostingList* postings : minus_postings) {
+                minus_cursors.push_back({postings->LowerBound(range_begin), postings->end()});
+            }
+
+            std::pair <int, double>* const slice = matches.data() + slice_offsets[task];
+            size_t match_count = 0;
+
+            for (;;) {
+                int64_t document_id = range_end;
+
+                for (const auto& [iter, end] : cursors) {
+                    if (iter != end && iter->document_id < document_id) {
+                        document_id = iter->document_id;
+                    }
+                }
+
+                if (document_id == range_end) {
+                    break;
+                }
+
+                const uint32_t ordinal = FindAcceptedDocument(k_mapper, static_cast <int> (document_id));
+                bool is_match = ordinal != DocumentTable::NO_ORDINAL;
+
+                if (is_match && !minus_cursors.empty()) {
+                    METRICS_LAP(minus_filter_timer);
+
+                    is_match = std::none_of(minus_cursors.begin(), minus_cursors.end(), [document_id](auto& minus_cursor) {
+                        return minus_cursor.first.SkipTo(document_id) != minus_cursor.second && minus_cursor.first->document_id == document_id;
+                    });
+                }
+
+                double relevance = 0.0;
+
+                for (size_t index = 0; index < cursors.size(); ++index) {
+                    auto& [iter, end] = cursors[index];
+
+                    if (iter != end && iter->document_id == document_id) {
+                        if (is_match) {
+                            relevance += ComputeTermFreq(iter->count, documents_.GetWordCount(ordinal)) * plus_postings[index].second;
+                        }
+
+                        ++iter;
+                    }
+                }
+
+                if (is_match) {
+                    slice[match_count++] = {static_cast <int> (document_id), relevance};
+                }
+            }
+
+            match_counts[task] = match_count;
+        });
+
+        // joins the slices; a slice never starts before the end of the ones already joined
+        size_t match_count = 0;
+
+        for (int64_t task = 0; task < task_count; ++task) {
+            std::copy_n(matches.begin() + slice_offsets[task], match_counts[task], matches.begin() + match_count);
+            match_count += match_counts[task];
+        }
+
+        matches.resize(match_count);
+
+        METRICS_ADD(MetricCounter::POSTINGS_SCANNED, postings_scanned);
+        METRICS_RECORD(MetricHistogram::POSTINGS_PER_QUERY, postings_scanned);
     }
 
-    for (const std::string& word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+    METRICS_SCOPED_TIMER(MetricHistogram::QUERY_RANKING);
+    METRICS_ADD(MetricCounter::DOCUMENTS_MATCHED, matches.size());
+    METRICS_RECORD(MetricHistogram::DOCUMENTS_PER_QUERY, matches.size());
+
+    return SelectTopDocuments(matches, options);
+}
+
+/*
+ * MaxScore. Plus terms are ordered by the most they can add to a score. While the heap is full,
+ * the cheapest terms whose bounds together cannot lift a document past the weakest kept one
+ * (by more than the ACCURACY tie band) are non-essential: candidates are drawn only from the
+ * other lists, and the non-essential lists are just probed for them, skipping whole blocks.
+ * Candidates come in id order and go through the same heap steps as SelectTopDocuments; a
+ * document is passed over only when that heap would turn it down at the same point, and the
+ * essential set is recomputed on every heap change, so the result equals the exhaustive one.
+ * A relevance is still summed over the terms in plus word order, so it is bit-identical too.
+ */
+template <typename KeyMapper>
+std::vector <Document> SearchServer::FindTopDocumentsMaxScore(const Query& query, KeyMapper& k_mapper, const SearchOptions& options, const std::vector <double>* inverse_document_freqs) const {
+    const size_t max_count = options.max_result_count;
+    std::vector <Document> top_documents;
+
+    if (max_count == 0) {
+        return top_documents;
+    }
+
+    // the minus filter and the ranking run inside accumulation, each is also recorded on its own
+    METRICS_SCOPED_TIMER(MetricHistogram::QUERY_ACCUMULATION);
+    ScratchArena::Scope scratch;
+    std::pmr::vector <ScoreCursor> cursors(scratch.GetResource());
+    size_t total_postings = 0;
+
+    for (size_t word_index = 0; word_index < query.plus_words.size(); ++word_index) {
+        const uint32_t term_id = FindPlusTerm(query, word_index);
+
+        if (term_id == TermDictionary::NO_TERM || document_freqs_[term_id] == 0) {
             continue;
         }
 
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+        const double inverse_document_freq = inverse_document_freqs == nullptr ? ComputeWordInverseDocumentFreq(term_id) : (*inverse_document_freqs)[word_index];
+        const PostingList& postings = postings_[term_id];
+
+        cursors.push_back({postings.begin(), postings.end(), inverse_document_freq, max_term_freqs_[term_id] * inverse_document_freq, word_index});
+        total_postings += postings.size();
+    }
+
+    std::pmr::vector <std::pair <PostingList::const_iterator, PostingList::const_iterator>> minus_cursors(scratch.GetResource());
+
+    for (size_t word_index = 0; word_index < query.minus_words.size(); ++word_index) {
+        if (const PostingList* postings = FindMinusPostings(query, word_index); postings != nullptr) {
+            minus_cursors.push_back({postings->begin(), postings->end()});
         }
     }
 
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+    std::sort(cursors.begin(), cursors.end(), [](const ScoreCursor& lhs, const ScoreCursor& rhs) {
+        return lhs.max_score == rhs.max_score ? lhs.word_index < rhs.word_index : lhs.max_score < rhs.max_score;
+    });
+
+    // score_bounds[i]: the most the first i cursors can add together
+    std::pmr::vector <double> score_bounds(cursors.size() + 1, 0.0, scratch.GetResource());
+
+    for (size_t index = 0; index < cursors.size(); ++index) {
+        score_bounds[index + 1] = score_bounds[index] + cursors[index].max_score;
+    }
+
+    // a document scoring below this is turned down by the heap's weakest element whatever its rating
+    auto threshold = [&top_documents]() {
+        return top_documents.front().relevance - 2 * ACCURACY;
+    };
+
+    // every candidate is a live document with a plus word, whatever the caller asked for
+    top_documents.reserve(std::min({max_count, total_postings, documents_.GetLiveCount()}));
+    // the minus words are probed per candidate, only for the ones that get scored
+    METRICS_ACCUMULATED_TIMER(minus_filter_timer, MetricHistogram::QUERY_MINUS_FILTER);
+    std::pmr::vector <std::pair <size_t, double>> contributions(scratch.GetResource());
+    size_t first_essential = 0;
+    int64_t next_document_id = 0;
+    size_t postings_visited = 0;
+    size_t documents_scored = 0;
+
+    while (first_essential < cursors.size()) {
+        int64_t document_id = INT64_MAX;
+
+        for (size_t index = first_essential; index < cursors.size(); ++index) {
+            ScoreCursor& cursor = cursors[index];
+
+            if (cursor.iter.SkipTo(next_document_id) != cursor.end) {
+                document_id = std::min <int64_t> (document_id, cursor.iter->document_id);
+            }
+        }
+
+        if (document_id == INT64_MAX) {
+            break;
+        }
+
+        next_document_id = document_id + 1;
+
+        const bool is_full = top_documents.size() == max_count;
+        double score_bound = score_bounds[first_essential];
+
+        for (size_t index = first_essential; index < cursors.size(); ++index) {
+            if (cursors[index].iter != cursors[index].end && cursors[index].iter->document_id == document_id) {
+                score_bound += cursors[index].max_score;
+                ++postings_visited;
+            }
+        }
+
+        if (is_full && score_bound < threshold()) {
+            continue;
+        }
+
+        const uint32_t ordinal = FindAcceptedDocument(k_mapper, static_cast <int> (document_id));
+
+        if (ordinal == DocumentTable::NO_ORDINAL) {
+            continue;
+        }
+
+        bool is_excluded = false;
+
+        if (!minus_cursors.empty()) {
+            METRICS_LAP(minus_filter_timer);
+
+            is_excluded = std::any_of(minus_cursors.begin(), minus_cursors.end(), [document_id](auto& minus_cursor) {
+                return minus_cursor.first.SkipTo(document_id) != minus_cursor.second && minus_cursor.first->document_id == document_id;
+            });
+        }
+
+        if (is_excluded) {
+            continue;
+        }
+
+        const uint32_t word_count = documents_.GetWordCount(ordinal);
+        contributions.clear();
+        double score = 0.0;
+
+        for (size_t index = first_essential; index < cursors.size(); ++index) {
+            const ScoreCursor& cursor = cursors[index];
+
+            if (cursor.iter != cursor.end && cursor.iter->document_id == document_id) {
+                contributions.push_back({cursor.word_index, ComputeTermFreq(cursor.iter->count, word_count) * cursor.inverse_document_freq});
+                score += contributions.back().second;
+            }
+        }
+
+        bool is_pruned = false;
+
+        // the dearest non-essential terms first, so the bound tightens fastest
+        for (size_t index = first_essential; index-- > 0; ) {
+            if (is_full && score + score_bounds[index + 1] < threshold()) {
+                is_pruned = true;
+                break;
+            }
+
+            ScoreCursor& cursor = cursors[index];
+
+            if (cursor.iter.SkipTo(document_id) != cursor.end && cursor.iter->document_id == document_id) {
+                contributions.push_back({cursor.word_index, ComputeTermFreq(cursor.iter->count, word_count) * cursor.inverse_document_freq});
+                score += contributions.back().second;
+                ++postings_visited;
+            }
+        }
+
+        if (is_pruned) {
+            continue;
+        }
+
+        std::sort(contributions.begin(), contributions.end());
+        double relevance = 0.0;
+
+        for (const auto& [_, contribution] : contributions) {
+            relevance += contribution;
+        }
+
+        ++documents_scored;
+        const Document document(static_cast <int> (document_id), relevance, documents_.GetRating(ordinal));
+
+        if (!IsAfter(options, document) || !OfferTopDocument(top_documents, document, max_count) || top_documents.size() < max_count) {
+            continue;
+        }
+
+        first_essential = 0;
+
+        while (first_essential < cursors.size() && score_bounds[first_essential + 1] < threshold()) {
+            ++first_essential;
+        }
+    }
+
+    METRICS_ADD(MetricCounter::POSTINGS_SCANNED, postings_visited);
+    METRICS_ADD(MetricCounter::POSTINGS_SKIPPED, total_postings - postings_visited);
+    METRICS_RECORD(MetricHistogram::POSTINGS_PER_QUERY, postings_visited);
+    METRICS_ADD(MetricCounter::DOCUMENTS_MATCHED, documents_scored);
+    METRICS_RECORD(MetricHistogram::DOCUMENTS_PER_QUERY, documents_scored);
+
+    {
+        METRICS_SCOPED_TIMER(MetricHistogram::QUERY_RANKING);
+        std::sort_heap(top_documents.begin(), top_documents.end(), MoreRelevant());
     }
 
-    return matched_documents;
+    return top_documents;
 }
 
-void AddDocument(SearchServer& search_server, int document_id, const std::string& document, DocumentStatus status, const std::vector<int>& ratings);
+void AddDocument(SearchServer& search_server, int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
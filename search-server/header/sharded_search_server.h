@@ -0,0 +1,102 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include <algorithm>
+#include <execution>
+#include <stdexcept>
+
+#include "search_server.h"
+#include "document.h"
+
+/*
+ * Documents are partitioned across shards by id. Every shard is a SearchServer behind its own
+ * lock, so writes to different shards run side by side. A query locks all shards for reading,
+ * scores them concurrently against corpus-wide document frequencies and merges the per-shard
+ * tops, so the result is the same as one SearchServer holding every document would give.
+ */
+class ShardedSearchServer {
+    public:
+        template <typename StringCollection>
+        ShardedSearchServer(size_t shard_count, const StringCollection& stop_words);
+        ShardedSearchServer(size_t shard_count, const std::string& stop_words);
+        ShardedSearchServer(size_t shard_count, std::string_view stop_words);
+
+        void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector <int>& ratings);
+        void RemoveDocument(int document_id);
+
+        // k_mapper is called from several threads at once
+        template <typename KeyMapper>
+        std::vector <Document> FindTopDocuments(std::string_view raw_query, KeyMapper k_mapper, const SearchOptions& options = {}) const;
+        std::vector <Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status, const SearchOptions& options = {}) const;
+        std::vector <Document> FindTopDocuments(std::string_view raw_query, const SearchOptions& options = {}) const;
+
+        std::tuple <std::vector <std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+
+        int GetDocumentCount() const;
+        size_t GetShardCount() const;
+
+    private:
+        struct Shard {
+            template <typename StopWords>
+            explicit Shard(const StopWords& stop_words)
+                : server(stop_words) {}
+
+            mutable std::shared_mutex mutex;
+            SearchServer server;
+        };
+
+        // deque: shards are never moved, so their mutexes stay put
+        std::deque <Shard> shards_;
+
+        template <typename StopWords>
+        void CreateShards(size_t shard_count, const StopWords& stop_words);
+
+        Shard& GetShard(int document_id);
+        const Shard& GetShard(int document_id) const;
+
+        std::vector <std::shared_lock <std::shared_mutex>> LockAllShared() const;
+
+        // expects every shard to be locked
+        std::vector <double> ComputeInverseDocumentFreqs(const SearchServer::Query& query) const;
+
+        static std::vector <Document> MergeTopDocuments(const std::vector <std::vector <Document>>& shard_top_documents, size_t max_count);
+};
+
+template <typename StringCollection>
+ShardedSearchServer::ShardedSearchServer(size_t shard_count, const StringCollection& stop_words) {
+    CreateShards(shard_count, stop_words);
+}
+
+template <typename StopWords>
+void ShardedSearchServer::CreateShards(size_t shard_count, const StopWords& stop_words) {
+    if (shard_count == 0) {
+        throw std::invalid_argument("shard count must be positive"s);
+    }
+
+    for (size_t shard = 0; shard < shard_count; ++shard) {
+        shards_.emplace_back(stop_words);
+    }
+}
+
+template <typename KeyMapper>
+std::vector <Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query, KeyMapper k_mapper, const SearchOptions& options) const {
+    // every shard has the same stop words, so any of them parses the query
+    ScratchArena::Scope scratch;
+    const SearchServer::Query query = shards_.front().server.ParseQuery(raw_query, scratch.GetResource());
+    const auto locks = LockAllShared();
+    const std::vector <double> inverse_document_freqs = ComputeInverseDocumentFreqs(query);
+
+    std::vector <std::vector <Document>> shard_top_documents(shards_.size());
+
+    std::transform(std::execution::par, shards_.begin(), shards_.end(), shard_top_documents.begin(), [&](const Shard& shard) {
+        return shard.server.FindAllDocuments(std::execution::seq, query, k_mapper, options, &inverse_document_freqs);
+    });
+
+    return MergeTopDocuments(shard_top_documents, options.max_result_count);
+}
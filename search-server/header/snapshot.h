@@ -0,0 +1,167 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+/*
+ * Binary index snapshot, version 4. All integers are host-endian and every array starts on an
+ * 8-byte boundary, so a mapped file can be read in place:
+ *
+ *   SnapshotHeader
+ *   stop words            string table
+ *   terms                 string table, in term id order
+ *   sorted term ids       uint32[term_count], the term ids in word order
+ *   document freqs        uint32[term_count], live postings of the term
+ *   posting byte offsets  uint64[term_count + 1]
+ *   posting bytes         uint8[], the encoded posting list of every term (see posting_list.h)
+ *   block offsets         uint64[term_count + 1]
+ *   posting blocks        PostingList::Block[], byte offsets relative to the term's bytes, padding zeroed
+ *   max term freqs        double[term_count], upper bound of the term's TF in any document
+ *   document ids          int32[document_count], ascending
+ *   document ratings      int32[document_count]
+ *   document statuses     int32[document_count]
+ *   document word counts  uint32[document_count]
+ *   forward offsets       uint64[document_count + 1]
+ *   forward index         uint32[], term ids per document in word order
+ *
+ * An array is a uint64 element count followed by the elements; a string table is the array of
+ * count + 1 offsets followed by the array of characters.
+ */
+
+const char SNAPSHOT_MAGIC[8] = {'S', 'R', 'C', 'H', 'S', 'N', 'A', 'P'};
+const uint32_t SNAPSHOT_VERSION = 4;
+const uint32_t SNAPSHOT_ENDIAN_TAG = 0x01020304;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian_tag;
+    uint64_t payload_size;
+    uint64_t checksum;
+};
+
+template <typename T>
+struct SnapshotArray {
+    const T* data = nullptr;
+    size_t size = 0;
+
+    const T* begin() const { return data; }
+    const T* end() const { return data + size; }
+    const T& operator[] (size_t index) const { return data[index]; }
+};
+
+// String i is characters[offsets[i], offsets[i + 1])
+struct SnapshotStrings {
+    SnapshotArray <uint64_t> offsets;
+    SnapshotArray <char> characters;
+
+    size_t size() const { return offsets.size - 1; }
+    std::string_view operator[] (size_t index) const { return std::string_view(characters.data + offsets[index], offsets[index + 1] - offsets[index]); }
+};
+
+// Word-at-a-time hash of the payload; bytes fed in pieces are joined into whole 8-byte words
+class SnapshotChecksum {
+    public:
+        void Update(const char* data, size_t size);
+        uint64_t Get() const;
+
+    private:
+        uint64_t state_ = 0x9E3779B97F4A7C15ull;
+        uint64_t length_ = 0;
+        char pending_[8] = {};
+        size_t pending_size_ = 0;
+
+        void AddWord(const char* data);
+};
+
+class SnapshotWriter {
+    public:
+        explicit SnapshotWriter(std::ostream& output);
+
+        template <typename T>
+        void WriteArray(const T* data, size_t count);
+        void WriteStrings(const std::vector <std::string_view>& strings);
+
+        // Streams one array in pieces: BeginArray, then AppendElements until count elements are out, then EndArray
+        void BeginArray(size_t count);
+        template <typename T>
+        void AppendElements(const T* data, size_t count);
+        void EndArray();
+
+        uint64_t GetPayloadSize() const;
+        uint64_t GetChecksum() const;
+
+    private:
+        std::ostream& output_;
+        SnapshotChecksum checksum_;
+        uint64_t payload_size_ = 0;
+        uint64_t array_bytes_ = 0;
+
+        void WriteBytes(const char* data, size_t size);
+};
+
+class SnapshotReader {
+    public:
+        SnapshotReader(const char* data, size_t size);
+
+        template <typename T>
+        SnapshotArray <T> ReadArray();
+        std::vector <std::string_view> ReadStrings();
+        // Checks the offsets but views the table in place
+        SnapshotStrings ReadStringTable();
+
+        bool AtEnd() const;
+
+    private:
+        const char* data_;
+        size_t size_;
+        size_t position_ = 0;
+};
+
+template <typename T>
+void SnapshotWriter::WriteArray(const T* data, size_t count) {
+    BeginArray(count);
+    AppendElements(data, count);
+    EndArray();
+}
+
+template <typename T>
+void SnapshotWriter::AppendElements(const T* data, size_t count) {
+    static_assert(std::is_trivially_copyable_v <T>, "snapshot arrays hold raw bytes");
+
+    WriteBytes(reinterpret_cast <const char*> (data), count * sizeof(T));
+    array_bytes_ += count * sizeof(T);
+}
+
+template <typename T>
+SnapshotArray <T> SnapshotReader::ReadArray() {
+    static_assert(std::is_trivially_copyable_v <T> && alignof(T) <= 8, "snapshot arrays hold raw bytes");
+
+    uint64_t count = 0;
+
+    if (size_ - position_ < sizeof(count)) {
+        throw std::invalid_argument("truncated snapshot");
+    }
+
+    std::memcpy(&count, data_ + position_, sizeof(count));
+    position_ += sizeof(count);
+
+    if (count > (size_ - position_) / sizeof(T)) {
+        throw std::invalid_argument("truncated snapshot");
+    }
+
+    SnapshotArray <T> array{reinterpret_cast <const T*> (data_ + position_), static_cast <size_t> (count)};
+    position_ += (count * sizeof(T) + 7) / 8 * 8;
+
+    if (position_ > size_) {
+        throw std::invalid_argument("truncated snapshot");
+    }
+
+    return array;
+}
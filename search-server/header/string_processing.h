@@ -1,6 +1,30 @@
 #pragma once
 
 #include <vector>
-#include <string>
+#include <memory_resource>
+#include <string_view>
 
-std::vector <std::string> SplitIntoWords(const std::string& text);
+// Words of a text split on spaces (empty ones dropped) and whether the text holds a control character
+struct TokenizedText {
+    std::pmr::vector <std::string_view> words;
+    bool has_control_characters = false;
+};
+
+// Instruction sets the tokenizer has a version for; the best one the CPU runs is picked at first use
+enum class TokenizerIsa {
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+
+// The words are allocated from resource, e.g. a ScratchArena scope's
+TokenizedText TokenizeText(std::string_view text, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+// A control character is any byte below ' '; bytes of multi-byte UTF-8 sequences never are
+bool HasControlCharacters(std::string_view text);
+std::vector <std::string_view> SplitIntoWords(std::string_view text);
+
+TokenizerIsa GetTokenizerIsa();
+bool IsTokenizerIsaSupported(TokenizerIsa isa);
+// Runs one particular version; the CPU must support it
+TokenizedText TokenizeText(TokenizerIsa isa, std::string_view text, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+bool HasControlCharacters(TokenizerIsa isa, std::string_view text);
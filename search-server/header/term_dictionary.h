@@ -0,0 +1,52 @@
+#pragma once
+
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Maps every indexed word to a dense id, so postings and forward lists can be addressed by position.
+// The dictionary owns the only copy of each word; lookups and returned views never allocate.
+// Words are packed back to back into a monotonic arena, which is only released with the dictionary.
+// The first ids may instead view a snapshot's word table in place, found by binary search over
+// the ids in word order; words interned later get the next ids as usual.
+class TermDictionary {
+    public:
+        static constexpr uint32_t NO_TERM = UINT32_MAX;
+
+        TermDictionary() = default;
+        TermDictionary(const TermDictionary&) = delete;
+        TermDictionary& operator= (const TermDictionary&) = delete;
+        TermDictionary(TermDictionary&&) = default;
+        TermDictionary& operator= (TermDictionary&&) = default;
+
+        uint32_t Find(std::string_view word) const;
+        uint32_t Intern(std::string_view word);
+
+        std::string_view GetWord(uint32_t term_id) const;
+
+        // Views word_count words as ids 0...: word i is characters[offsets[i], offsets[i + 1]), and
+        // sorted_term_ids lists the ids in word order. Only for an empty dictionary; nothing is copied
+        // or checked, and the memory must outlive the dictionary.
+        void View(const uint64_t* offsets, const char* characters, const uint32_t* sorted_term_ids, size_t word_count);
+
+        size_t size() const;
+
+        // Approximate heap footprint of the words and the lookup table
+        size_t GetByteSize() const;
+
+    private:
+        const uint64_t* viewed_offsets_ = nullptr;
+        const char* viewed_characters_ = nullptr;
+        const uint32_t* viewed_sorted_term_ids_ = nullptr;
+        size_t viewed_word_count_ = 0;
+
+        // behind a pointer so a moved dictionary keeps its words where the views point
+        std::unique_ptr <std::pmr::monotonic_buffer_resource> storage_ = std::make_unique <std::pmr::monotonic_buffer_resource> ();
+        size_t stored_bytes_ = 0;
+        // ids from viewed_word_count_ on
+        std::vector <std::string_view> words_;
+        std::unordered_map <std::string_view, uint32_t> word_to_id_;
+};
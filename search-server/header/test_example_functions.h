@@ -2,8 +2,50 @@
 
 #include <iostream>
 #include <vector>
+#include <string>
 
 #include "search_server.h"
 #include "remove_duplicates.h"
+#include "sharded_search_server.h"
+#include "concurrent_search_server.h"
+#include "document_loader.h"
+#include "request_queue.h"
+#include "metrics.h"
+#include "paginator.h"
+#include "search_cursor.h"
+#include "snapshot.h"
+#include "process_queries.h"
 
-void text_example();
\ No newline at end of file
+#define ASSERT_HINT(expr, hint) AssertImpl(static_cast <bool> (expr), #expr, __FILE__, __FUNCTION__, __LINE__, (hint))
+#define ASSERT(expr) ASSERT_HINT(expr, ""s)
+
+void AssertImpl(bool value, const std::string& expr_str, const std::string& file, const std::string& func, unsigned line, const std::string& hint);
+
+void TestRelevanceMatchesIdfFormula();
+void TestResultCountAndTieBreak();
+void TestTokenizerMatchesReference();
+void TestScratchArena();
+void TestTermDictionary();
+void TestPostingList();
+void TestPostingListBlockBoundaries();
+void TestDocumentTable();
+void TestCompactKeepsResults();
+void TestMatchDocumentPolicies();
+void TestPruningMatchesExhaustive();
+void TestStatusFilterMatchesPredicate();
+void TestDocumentLoader();
+void TestRequestQueueAsync();
+void TestShardedSearchServer();
+void TestConcurrentSearchServerStress();
+void TestMetricsRegistry();
+void TestSearchCursor();
+void TestPreparedQuery();
+void TestProcessQueries();
+void TestRequestQueueCache();
+void TestSnapshot();
+void TestAddDocumentsMatchesLoop();
+void TestRemoveDuplicates();
+
+void TestSearchServer();
+
+void text_example();
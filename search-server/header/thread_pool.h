@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Fixed set of worker threads with a task deque each. A worker runs its own tasks newest first
+ * and, when it has none, steals the oldest task of another worker, so a burst submitted to one
+ * deque spreads over the pool. Tasks submitted from outside are dealt round-robin; a task
+ * submitted by a worker goes to that worker's deque. At most queue_capacity tasks wait at once:
+ * TrySubmit turns the next one away instead of letting the backlog grow.
+ */
+class ThreadPool {
+    public:
+        using Task = std::function <void()>;
+
+        // thread_count = 0 takes one thread per core
+        ThreadPool(size_t thread_count, size_t queue_capacity);
+        // Runs every task still waiting, then joins
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator= (const ThreadPool&) = delete;
+
+        // false, and the task is dropped, when queue_capacity tasks are already waiting
+        bool TrySubmit(Task task);
+
+        size_t GetThreadCount() const;
+        size_t GetQueueCapacity() const;
+        // Submitted and not yet started
+        size_t GetPendingCount() const;
+
+    private:
+        struct Worker {
+            std::mutex mutex;
+            std::deque <Task> tasks;
+        };
+
+        const size_t queue_capacity_;
+        std::vector <std::unique_ptr <Worker>> workers_;
+        std::atomic <size_t> pending_count_{0};
+        // tasks in the deques; changed under the deque's lock together with the deque
+        std::atomic <size_t> queued_count_{0};
+        std::atomic <size_t> next_worker_{0};
+        std::mutex sleep_mutex_;
+        std::condition_variable wake_;
+        bool is_stopping_ = false;
+        // last, so the workers start once everything else is built
+        std::vector <std::thread> threads_;
+
+        void Run(size_t worker_index);
+        bool TryTake(size_t worker_index, Task& task);
+};
@@ -7,6 +7,7 @@
 #include "header/read_input_functions.h"
 #include "header/search_server.h"
 #include "header/request_queue.h"
+#include "header/process_queries.h"
 #include "header/paginator.h"
 #include "header/test_example_functions.h"
 #include "header/remove_duplicates.h"
@@ -14,6 +15,7 @@
 using namespace std;
 
 int main() {
+    TestSearchServer();
     text_example();
 
     return 0;
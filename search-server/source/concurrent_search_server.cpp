@@ -0,0 +1,92 @@
+#include "../header/concurrent_search_server.h"
+
+ConcurrentSearchServer::Snapshot::Snapshot(Instance* instance)
+    : instance_(instance)
+{}
+
+ConcurrentSearchServer::Snapshot::Snapshot(Snapshot&& other) noexcept
+    : instance_(std::exchange(other.instance_, nullptr))
+{}
+
+ConcurrentSearchServer::Snapshot::~Snapshot() {
+    if (instance_ != nullptr) {
+        instance_->reader_count.fetch_sub(1);
+    }
+}
+
+const SearchServer& ConcurrentSearchServer::Snapshot::operator* () const {
+    return instance_->server;
+}
+
+const SearchServer* ConcurrentSearchServer::Snapshot::operator-> () const {
+    return &instance_->server;
+}
+
+ConcurrentSearchServer::ConcurrentSearchServer(const std::string& stop_words)
+    : ConcurrentSearchServer(std::string_view(stop_words))
+{}
+
+ConcurrentSearchServer::ConcurrentSearchServer(std::string_view stop_words)
+    : instances_{std::make_unique <Instance> (stop_words), std::make_unique <Instance> (stop_words)}
+    , published_(instances_[0].get())
+{}
+
+/*
+ * The reader announces itself on the instance it saw and then checks that the instance is still
+ * the published one. If a writer swapped it in between, the writer may already have stopped
+ * waiting for readers, so the reader steps back and tries the new instance instead.
+ */
+ConcurrentSearchServer::Snapshot ConcurrentSearchServer::AcquireSnapshot() const {
+    while (true) {
+        Instance* instance = published_.load();
+        instance->reader_count.fetch_add(1);
+
+        if (published_.load() == instance) {
+            return Snapshot(instance);
+        }
+
+        instance->reader_count.fetch_sub(1);
+    }
+}
+
+void ConcurrentSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector <int>& ratings) {
+    ApplyWrite([&](SearchServer& search_server) {
+        search_server.AddDocument(document_id, document, status, ratings);
+    });
+}
+
+std::vector <DocumentError> ConcurrentSearchServer::AddDocuments(const std::vector <DocumentRecord>& documents) {
+    std::vector <DocumentError> errors;
+
+    ApplyWrite([&](SearchServer& search_server) {
+        errors = search_server.AddDocuments(documents);
+    });
+
+    return errors;
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id) {
+    ApplyWrite([document_id](SearchServer& search_server) {
+        search_server.RemoveDocument(document_id);
+    });
+}
+
+void ConcurrentSearchServer::RemoveDocuments(const std::vector <int>& document_ids) {
+    ApplyWrite([&document_ids](SearchServer& search_server) {
+        search_server.RemoveDocuments(document_ids);
+    });
+}
+
+CompactionStats ConcurrentSearchServer::Compact() {
+    CompactionStats stats;
+
+    ApplyWrite([&stats](SearchServer& search_server) {
+        stats = search_server.Compact();
+    });
+
+    return stats;
+}
+
+int ConcurrentSearchServer::GetDocumentCount() const {
+    return AcquireSnapshot()->GetDocumentCount();
+}
@@ -0,0 +1,285 @@
+#include "../header/document_loader.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <exception>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+
+#include "../header/bounded_queue.h"
+#include "../header/mapped_file.h"
+#include "../header/string_processing.h"
+
+namespace {
+    constexpr size_t READ_BLOCK_SIZE = size_t{1} << 20;
+
+    int ParseInt(std::string_view text, const std::string& error_message) {
+        int value = 0;
+        const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+
+        if (text.empty() || error != std::errc() || end != text.data() + text.size()) {
+            throw std::invalid_argument(error_message);
+        }
+
+        return value;
+    }
+
+    DocumentStatus ParseStatus(std::string_view text) {
+        static const std::pair <std::string_view, DocumentStatus> statuses[] = {
+            {"ACTUAL", DocumentStatus::ACTUAL},
+            {"IRRELEVANT", DocumentStatus::IRRELEVANT},
+            {"BANNED", DocumentStatus::BANNED},
+            {"REMOVED", DocumentStatus::REMOVED},
+        };
+
+        for (const auto& [name, status] : statuses) {
+            if (text == name) {
+                return status;
+            }
+        }
+
+        throw std::invalid_argument("invalid status"s);
+    }
+}
+
+DocumentRecord ParseDocumentLine(std::string_view line) {
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+
+    std::string_view fields[3];
+
+    for (std::string_view& field : fields) {
+        const size_t tab = line.find('\t');
+
+        if (tab == std::string_view::npos) {
+            throw std::invalid_argument("missing fields"s);
+        }
+
+        field = line.substr(0, tab);
+        line.remove_prefix(tab + 1);
+    }
+
+    DocumentRecord record;
+    record.id = ParseInt(fields[0], "invalid id"s);
+    record.status = ParseStatus(fields[1]);
+
+    for (const std::string_view rating : SplitIntoWords(fields[2])) {
+        record.ratings.push_back(ParseInt(rating, "invalid rating"s));
+    }
+
+    record.text = std::string(line);
+
+    return record;
+}
+
+double LoadStats::GetMegabytesPerSecond() const {
+    return seconds > 0.0 ? bytes_read / 1e6 / seconds : 0.0;
+}
+
+double LoadStats::GetDocumentsPerSecond() const {
+    return seconds > 0.0 ? documents_added / seconds : 0.0;
+}
+
+// The partial indexes view the texts of documents: a batch may be moved as a whole, its records never
+struct DocumentLoader::Batch {
+    std::vector <DocumentRecord> documents;
+    // of every document
+    std::vector <size_t> line_numbers;
+    std::vector <LineError> parse_errors;
+    std::vector <SearchServer::PartialIndex> partial_indexes;
+    size_t bytes = 0;
+    size_t lines = 0;
+};
+
+DocumentLoader::DocumentLoader(SearchServer& search_server, const LoadOptions& options)
+    : search_server_(search_server)
+    , options_(options)
+{}
+
+/*
+ * Every stage closes the queues it touches when it leaves, normally or not: the stages after it
+ * drain what is queued and stop, the stages before it fail their next Push and stop. The first
+ * error, in pipeline order, is rethrown once all threads are joined.
+ */
+template <typename ReadLines>
+LoadStats DocumentLoader::Run(ReadLines read_lines) {
+    const auto start = std::chrono::steady_clock::now();
+    BoundedQueue <Batch> parsed_batches(options_.queue_capacity);
+    BoundedQueue <Batch> prepared_batches(options_.queue_capacity);
+    std::exception_ptr reader_error;
+    std::exception_ptr tokenizer_error;
+    std::exception_ptr indexer_error;
+
+    std::thread reader([&]() {
+        try {
+            Batch batch;
+            size_t line_number = 0;
+
+            auto on_line = [&](std::string_view line, size_t bytes) {
+                ++line_number;
+                ++batch.lines;
+                batch.bytes += bytes;
+
+                if (!line.empty() && line.back() == '\r') {
+                    line.remove_suffix(1);
+                }
+
+                if (!line.empty()) {
+                    try {
+                        batch.documents.push_back(ParseDocumentLine(line));
+                        batch.line_numbers.push_back(line_number);
+                    } catch (const std::invalid_argument& error) {
+                        batch.parse_errors.push_back({line_number, error.what()});
+                    }
+                }
+
+                if (batch.bytes < options_.batch_bytes) {
+                    return true;
+                }
+
+                const bool is_pushed = parsed_batches.Push(std::move(batch));
+                batch = {};
+
+                return is_pushed;
+            };
+
+            read_lines(on_line);
+
+            if (batch.lines > 0) {
+                parsed_batches.Push(std::move(batch));
+            }
+        } catch (...) {
+            reader_error = std::current_exception();
+        }
+
+        parsed_batches.Close();
+    });
+
+    std::thread tokenizer([&]() {
+        try {
+            while (std::optional <Batch> batch = parsed_batches.Pop()) {
+                std::vector <size_t> candidates;
+
+                // ids already in the server are tokenized too: the index may change before this batch is merged
+                for (size_t index = 0; index < batch->documents.size(); ++index) {
+                    if (batch->documents[index].id >= 0) {
+                        candidates.push_back(index);
+                    }
+                }
+
+                batch->partial_indexes = search_server_.PrepareDocuments(batch->documents, candidates);
+
+                if (!prepared_batches.Push(std::move(*batch))) {
+                    break;
+                }
+            }
+        } catch (...) {
+            tokenizer_error = std::current_exception();
+        }
+
+        parsed_batches.Close();
+        prepared_batches.Close();
+    });
+
+    LoadStats stats;
+
+    try {
+        while (std::optional <Batch> batch = prepared_batches.Pop()) {
+            const std::vector <DocumentError> document_errors = search_server_.CommitDocuments(batch->documents, batch->partial_indexes);
+            std::vector <LineError> errors;
+
+            for (const DocumentError& document_error : document_errors) {
+                errors.push_back({batch->line_numbers[document_error.index], document_error.message});
+            }
+
+            std::merge(std::make_move_iterator(batch->parse_errors.begin()), std::make_move_iterator(batch->parse_errors.end()),
+                std::make_move_iterator(errors.begin()), std::make_move_iterator(errors.end()), std::back_inserter(stats.errors),
+                [](const LineError& lhs, const LineError& rhs) {
+                    return lhs.line_number < rhs.line_number;
+                });
+
+            stats.bytes_read += batch->bytes;
+            stats.lines_read += batch->lines;
+            stats.documents_added += batch->documents.size() - document_errors.size();
+        }
+    } catch (...) {
+        indexer_error = std::current_exception();
+    }
+
+    parsed_batches.Close();
+    prepared_batches.Close();
+    reader.join();
+    tokenizer.join();
+
+    for (const std::exception_ptr& error : {reader_error, tokenizer_error, indexer_error}) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    stats.seconds = std::chrono::duration <double> (std::chrono::steady_clock::now() - start).count();
+
+    return stats;
+}
+
+LoadStats DocumentLoader::Load(std::istream& input) {
+    return Run([&input](auto& on_line) {
+        std::vector <char> block(READ_BLOCK_SIZE);
+        // the unterminated end of the previous block
+        std::string pending;
+
+        for (;;) {
+            input.read(block.data(), block.size());
+            const std::string_view text(block.data(), static_cast <size_t> (input.gcount()));
+            size_t line_begin = 0;
+
+            for (size_t line_end = text.find('\n'); line_end != std::string_view::npos; line_end = text.find('\n', line_begin)) {
+                pending.append(text.substr(line_begin, line_end - line_begin));
+
+                if (!on_line(std::string_view(pending), pending.size() + 1)) {
+                    return;
+                }
+
+                pending.clear();
+                line_begin = line_end + 1;
+            }
+
+            pending.append(text.substr(line_begin));
+
+            if (!input) {
+                break;
+            }
+        }
+
+        if (input.bad()) {
+            throw std::runtime_error("cannot read input"s);
+        }
+
+        if (!pending.empty()) {
+            on_line(std::string_view(pending), pending.size());
+        }
+    });
+}
+
+LoadStats DocumentLoader::LoadFile(const std::string& path) {
+    const MappedFile file(path);
+
+    return Run([&file](auto& on_line) {
+        const std::string_view text(file.data(), file.size());
+        size_t line_begin = 0;
+
+        while (line_begin < text.size()) {
+            const size_t line_end = std::min(text.find('\n', line_begin), text.size());
+
+            if (!on_line(text.substr(line_begin, line_end - line_begin), std::min(line_end + 1, text.size()) - line_begin)) {
+                return;
+            }
+
+            line_begin = line_end + 1;
+        }
+    });
+}
@@ -0,0 +1,239 @@
+#include "../header/document_table.h"
+
+#include <algorithm>
+
+uint32_t DocumentTable::Add(int document_id, int rating, DocumentStatus status, uint32_t word_count, std::vector <uint32_t> term_ids) {
+    const auto ordinal = static_cast <uint32_t> (ids_.size());
+
+    ids_.push_back(document_id);
+    ratings_.push_back(rating);
+    statuses_.push_back(status);
+    word_counts_.push_back(word_count);
+    term_ids_.push_back(std::move(term_ids));
+    live_.push_back(true);
+
+    for (size_t index = 0; index < STATUS_COUNT; ++index) {
+        status_bits_[index].push_back(index == static_cast <size_t> (status));
+    }
+
+    GetOrdinalSlot(document_id) = ordinal;
+    min_live_id_ = live_count_ == 0 ? document_id : std::min(min_live_id_, document_id);
+    max_live_id_ = live_count_ == 0 ? document_id : std::max(max_live_id_, document_id);
+    ++live_count_;
+
+    return ordinal;
+}
+
+void DocumentTable::RenumberTerms(const std::vector <uint32_t>& new_term_ids) {
+    DetachTermIds();
+
+    for (std::vector <uint32_t>& term_ids : term_ids_) {
+        for (uint32_t& term_id : term_ids) {
+            term_id = new_term_ids[term_id];
+        }
+    }
+}
+
+void DocumentTable::ViewRows(size_t count, const int32_t* ids, const int32_t* ratings, const int32_t* statuses, const uint32_t* word_counts,
+        const uint64_t* term_offsets, const uint32_t* term_ids) {
+    ids_.assign(ids, ids + count);
+    ratings_.assign(ratings, ratings + count);
+    statuses_.resize(count);
+    word_counts_.assign(word_counts, word_counts + count);
+    live_.assign(count, true);
+
+    for (std::vector <bool>& bits : status_bits_) {
+        bits.assign(count, false);
+    }
+
+    for (uint32_t ordinal = 0; ordinal < count; ++ordinal) {
+        statuses_[ordinal] = static_cast <DocumentStatus> (statuses[ordinal]);
+        status_bits_[static_cast <size_t> (statuses[ordinal])][ordinal] = true;
+        GetOrdinalSlot(ids[ordinal]) = ordinal;
+    }
+
+    mapped_term_offsets_ = term_offsets;
+    mapped_term_ids_ = term_ids;
+    mapped_row_count_ = count;
+    live_count_ = count;
+
+    if (count > 0) {
+        const auto [min_iter, max_iter] = std::minmax_element(ids, ids + count);
+        min_live_id_ = *min_iter;
+        max_live_id_ = *max_iter;
+    }
+}
+
+// The bounds move past the ids removed before them, so removing in id order walks the span once
+void DocumentTable::MarkRemoved(uint32_t ordinal) {
+    live_[ordinal] = false;
+    status_bits_[static_cast <size_t> (statuses_[ordinal])][ordinal] = false;
+    --live_count_;
+
+    if (live_count_ == 0) {
+        return;
+    }
+
+    if (ids_[ordinal] == min_live_id_) {
+        min_live_id_ = *LiveIdIterator(this, static_cast <int64_t> (min_live_id_) + 1);
+    }
+
+    if (ids_[ordinal] == max_live_id_) {
+        int64_t document_id = max_live_id_ - 1;
+
+        while (FindLive(static_cast <int> (document_id)) == NO_ORDINAL) {
+            const size_t page = static_cast <size_t> (document_id) >> PAGE_BITS;
+            document_id = ordinal_pages_[page] == nullptr ? static_cast <int64_t> (page << PAGE_BITS) - 1 : document_id - 1;
+        }
+
+        max_live_id_ = static_cast <int> (document_id);
+    }
+}
+
+void DocumentTable::Release(int document_id) {
+    uint32_t& slot = GetOrdinalSlot(document_id);
+
+    if (slot >= mapped_row_count_) {
+        std::vector <uint32_t> ().swap(term_ids_[slot - mapped_row_count_]);
+    }
+
+    slot = NO_ORDINAL;
+}
+
+// An id whose slot points elsewhere was released and maybe added again: only its dead row goes
+void DocumentTable::Compact() {
+    if (live_count_ == ids_.size()) {
+        return;
+    }
+
+    DocumentTable compacted;
+    compacted.ordinal_pages_ = std::move(ordinal_pages_);
+
+    for (uint32_t ordinal = 0; ordinal < ids_.size(); ++ordinal) {
+        if (live_[ordinal] && ordinal < mapped_row_count_) {
+            const TermIdSpan term_ids = GetTermIds(ordinal);
+            compacted.Add(ids_[ordinal], ratings_[ordinal], statuses_[ordinal], word_counts_[ordinal], std::vector <uint32_t> (term_ids.begin(), term_ids.end()));
+        } else if (live_[ordinal]) {
+            compacted.Add(ids_[ordinal], ratings_[ordinal], statuses_[ordinal], word_counts_[ordinal], std::move(term_ids_[ordinal - mapped_row_count_]));
+        } else if (compacted.Find(ids_[ordinal]) == ordinal) {
+            compacted.GetOrdinalSlot(ids_[ordinal]) = NO_ORDINAL;
+        }
+    }
+
+    *this = std::move(compacted);
+}
+
+size_t DocumentTable::size() const {
+    return ids_.size();
+}
+
+size_t DocumentTable::GetLiveCount() const {
+    return live_count_;
+}
+
+DocumentTable::LiveIdIterator DocumentTable::begin() const {
+    return live_count_ == 0 ? LiveIdIterator() : LiveIdIterator(this, min_live_id_);
+}
+
+DocumentTable::LiveIdIterator DocumentTable::end() const {
+    return LiveIdIterator();
+}
+
+int DocumentTable::GetMinLiveId() const {
+    return min_live_id_;
+}
+
+int DocumentTable::GetMaxLiveId() const {
+    return max_live_id_;
+}
+
+size_t DocumentTable::GetByteSize() const {
+    size_t byte_size = ordinal_pages_.capacity() * sizeof(std::unique_ptr <uint32_t[]>)
+        + ids_.capacity() * sizeof(int)
+        + ratings_.capacity() * sizeof(int)
+        + statuses_.capacity() * sizeof(DocumentStatus)
+        + word_counts_.capacity() * sizeof(uint32_t)
+        + term_ids_.capacity() * sizeof(std::vector <uint32_t>)
+        + live_.capacity() / 8 * (STATUS_COUNT + 1);
+
+    for (const auto& page : ordinal_pages_) {
+        byte_size += page == nullptr ? 0 : PAGE_SIZE * sizeof(uint32_t);
+    }
+
+    for (const std::vector <uint32_t>& term_ids : term_ids_) {
+        byte_size += term_ids.capacity() * sizeof(uint32_t);
+    }
+
+    return byte_size;
+}
+
+uint32_t& DocumentTable::GetOrdinalSlot(int document_id) {
+    const size_t page = static_cast <size_t> (document_id) >> PAGE_BITS;
+
+    if (page >= ordinal_pages_.size()) {
+        ordinal_pages_.resize(page + 1);
+    }
+
+    if (ordinal_pages_[page] == nullptr) {
+        ordinal_pages_[page].reset(new uint32_t[PAGE_SIZE]);
+        std::fill_n(ordinal_pages_[page].get(), PAGE_SIZE, NO_ORDINAL);
+    }
+
+    return ordinal_pages_[page][document_id & (PAGE_SIZE - 1)];
+}
+
+// Released rows are left empty: nothing reads their terms again
+void DocumentTable::DetachTermIds() {
+    if (mapped_row_count_ == 0) {
+        return;
+    }
+
+    std::vector <std::vector <uint32_t>> term_ids(mapped_row_count_);
+
+    for (uint32_t ordinal = 0; ordinal < mapped_row_count_; ++ordinal) {
+        if (Find(ids_[ordinal]) == ordinal) {
+            const TermIdSpan mapped_term_ids = GetTermIds(ordinal);
+            term_ids[ordinal].assign(mapped_term_ids.begin(), mapped_term_ids.end());
+        }
+    }
+
+    std::move(term_ids_.begin(), term_ids_.end(), std::back_inserter(term_ids));
+    term_ids_ = std::move(term_ids);
+    mapped_term_offsets_ = nullptr;
+    mapped_term_ids_ = nullptr;
+    mapped_row_count_ = 0;
+}
+
+DocumentTable::LiveIdIterator::LiveIdIterator(const DocumentTable* documents, int64_t document_id) : documents_(documents) {
+    SkipDead(document_id);
+}
+
+DocumentTable::LiveIdIterator& DocumentTable::LiveIdIterator::operator++ () {
+    SkipDead(static_cast <int64_t> (document_id_) + 1);
+    return *this;
+}
+
+DocumentTable::LiveIdIterator DocumentTable::LiveIdIterator::operator++ (int) {
+    LiveIdIterator previous = *this;
+    ++*this;
+    return previous;
+}
+
+// Whole pages that were never allocated are stepped over at once
+void DocumentTable::LiveIdIterator::SkipDead(int64_t document_id) {
+    const auto& pages = documents_->ordinal_pages_;
+
+    for (size_t page = static_cast <size_t> (document_id) >> PAGE_BITS; page < pages.size(); page = static_cast <size_t> (document_id) >> PAGE_BITS) {
+        if (pages[page] == nullptr) {
+            document_id = static_cast <int64_t> ((page + 1) << PAGE_BITS);
+        } else if (documents_->FindLive(static_cast <int> (document_id)) != NO_ORDINAL) {
+            document_id_ = static_cast <int> (document_id);
+            return;
+        } else {
+            ++document_id;
+        }
+    }
+
+    documents_ = nullptr;
+    document_id_ = -1;
+}
@@ -0,0 +1,76 @@
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SEARCH_SERVER_HAS_MMAP 1
+#endif
+
+#include "../header/mapped_file.h"
+
+using namespace std::string_literals;
+
+MappedFile::MappedFile(const std::string& path) {
+#ifdef SEARCH_SERVER_HAS_MMAP
+    const int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+        throw std::runtime_error("cannot open "s + path);
+    }
+
+    struct stat file_stat;
+
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        throw std::runtime_error("cannot stat "s + path);
+    }
+
+    size_ = static_cast <size_t> (file_stat.st_size);
+
+    if (size_ > 0) {
+        void* address = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (address == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("cannot map "s + path);
+        }
+
+        data_ = static_cast <const char*> (address);
+        is_mapped_ = true;
+    }
+
+    close(fd);
+#else
+    std::ifstream input(path, std::ios::binary | std::ios::ate);
+
+    if (!input) {
+        throw std::runtime_error("cannot open "s + path);
+    }
+
+    buffer_.resize(static_cast <size_t> (input.tellg()));
+    input.seekg(0);
+    input.read(buffer_.data(), buffer_.size());
+
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef SEARCH_SERVER_HAS_MMAP
+    if (is_mapped_) {
+        munmap(const_cast <char*> (data_), size_);
+    }
+#endif
+}
+
+const char* MappedFile::data() const {
+    return data_;
+}
+
+size_t MappedFile::size() const {
+    return size_;
+}
@@ -0,0 +1,233 @@
+#include <algorithm>
+#include <iomanip>
+
+#include "../header/metrics.h"
+
+namespace {
+    const char* const COUNTER_NAMES[] = {"queries", "postings_scanned", "postings_skipped", "documents_matched"};
+
+    const char* const HISTOGRAM_NAMES[] = {
+        "query_total_ns", "query_validation_ns", "query_parse_ns", "query_accumulation_ns",
+        "query_minus_filter_ns", "query_ranking_ns", "postings_per_query", "documents_per_query"
+    };
+
+    static_assert(std::size(COUNTER_NAMES) == METRIC_COUNTER_COUNT && std::size(HISTOGRAM_NAMES) == METRIC_HISTOGRAM_COUNT);
+
+    // only the owning thread writes a slot, so a plain load and store are enough
+    void AddRelaxed(std::atomic <uint64_t>& target, uint64_t value) {
+        target.store(target.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    uint64_t ComputeQuantile(const std::array <uint64_t, MetricsRegistry::BUCKET_COUNT>& buckets, uint64_t count, uint64_t max, double share) {
+        const uint64_t rank = std::max <uint64_t> (1, static_cast <uint64_t> (share * count + 0.999999));
+        uint64_t seen = 0;
+
+        for (size_t bucket = 0; bucket < buckets.size(); ++bucket) {
+            seen += buckets[bucket];
+
+            if (seen >= rank) {
+                return std::min(MetricsRegistry::GetBucketUpperBound(bucket), max);
+            }
+        }
+
+        return max;
+    }
+}
+
+const char* GetMetricName(MetricCounter counter) {
+    return COUNTER_NAMES[static_cast <size_t> (counter)];
+}
+
+const char* GetMetricName(MetricHistogram histogram) {
+    return HISTOGRAM_NAMES[static_cast <size_t> (histogram)];
+}
+
+uint64_t MetricsSnapshot::GetCounter(MetricCounter counter) const {
+    return counters[static_cast <size_t> (counter)];
+}
+
+const HistogramSummary& MetricsSnapshot::GetHistogram(MetricHistogram histogram) const {
+    return histograms[static_cast <size_t> (histogram)];
+}
+
+void PrintMetrics(std::ostream& output, const MetricsSnapshot& snapshot) {
+    for (size_t counter = 0; counter < METRIC_COUNTER_COUNT; ++counter) {
+        output << std::left << std::setw(24) << COUNTER_NAMES[counter] << snapshot.counters[counter] << '\n';
+    }
+
+    for (size_t histogram = 0; histogram < METRIC_HISTOGRAM_COUNT; ++histogram) {
+        const HistogramSummary& summary = snapshot.histograms[histogram];
+
+        output << std::left << std::setw(24) << HISTOGRAM_NAMES[histogram]
+               << "count " << summary.count << " p50 " << summary.p50 << " p99 " << summary.p99
+               << " p999 " << summary.p999 << " max " << summary.max << '\n';
+    }
+}
+
+// Folds the thread's totals into the registry when the thread exits
+class MetricsRegistry::ThreadSlot {
+    public:
+        ThreadSlot()
+            : registry_(MetricsRegistry::Instance())
+        {
+            registry_.Register(&metrics_);
+        }
+
+        ~ThreadSlot() {
+            registry_.Retire(&metrics_);
+        }
+
+        ThreadMetrics& Get() {
+            return metrics_;
+        }
+
+    private:
+        MetricsRegistry& registry_;
+        ThreadMetrics metrics_;
+};
+
+MetricsRegistry& MetricsRegistry::Instance() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+void MetricsRegistry::Add(MetricCounter counter, uint64_t value) {
+    AddRelaxed(GetThreadMetrics().counters[static_cast <size_t> (counter)], value);
+}
+
+void MetricsRegistry::Record(MetricHistogram histogram, uint64_t value) {
+    ThreadMetrics& thread_metrics = GetThreadMetrics();
+    const size_t index = static_cast <size_t> (histogram);
+
+    AddRelaxed(thread_metrics.buckets[index][GetBucketIndex(value)], 1);
+    AddRelaxed(thread_metrics.sums[index], value);
+
+    if (thread_metrics.maxes[index].load(std::memory_order_relaxed) < value) {
+        thread_metrics.maxes[index].store(value, std::memory_order_relaxed);
+    }
+}
+
+MetricsSnapshot MetricsRegistry::TakeSnapshot() const {
+    ThreadMetrics total;
+
+    {
+        std::lock_guard <std::mutex> guard(mutex_);
+        MergeInto(total, retired_);
+
+        for (const ThreadMetrics* thread_metrics : threads_) {
+            MergeInto(total, *thread_metrics);
+        }
+    }
+
+    MetricsSnapshot snapshot;
+
+    for (size_t counter = 0; counter < METRIC_COUNTER_COUNT; ++counter) {
+        snapshot.counters[counter] = total.counters[counter].load(std::memory_order_relaxed);
+    }
+
+    for (size_t histogram = 0; histogram < METRIC_HISTOGRAM_COUNT; ++histogram) {
+        std::array <uint64_t, BUCKET_COUNT> buckets;
+        HistogramSummary& summary = snapshot.histograms[histogram];
+
+        for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+            buckets[bucket] = total.buckets[histogram][bucket].load(std::memory_order_relaxed);
+            summary.count += buckets[bucket];
+        }
+
+        summary.sum = total.sums[histogram].load(std::memory_order_relaxed);
+        summary.max = total.maxes[histogram].load(std::memory_order_relaxed);
+        summary.p50 = ComputeQuantile(buckets, summary.count, summary.max, 0.5);
+        summary.p99 = ComputeQuantile(buckets, summary.count, summary.max, 0.99);
+        summary.p999 = ComputeQuantile(buckets, summary.count, summary.max, 0.999);
+    }
+
+    return snapshot;
+}
+
+void MetricsRegistry::Reset() {
+    std::lock_guard <std::mutex> guard(mutex_);
+    Clear(retired_);
+
+    for (ThreadMetrics* thread_metrics : threads_) {
+        Clear(*thread_metrics);
+    }
+}
+
+// Values below 8 get a bucket each; above, the top 3 bits after the leading one pick the bucket within its power of two
+size_t MetricsRegistry::GetBucketIndex(uint64_t value) {
+    constexpr uint64_t sub_bucket_count = uint64_t(1) << SUB_BUCKET_BITS;
+
+    if (value < sub_bucket_count) {
+        return value;
+    }
+
+    size_t leading_bit = 63;
+
+    while ((value >> leading_bit) == 0) {
+        --leading_bit;
+    }
+
+    const size_t shift = leading_bit - SUB_BUCKET_BITS;
+    return ((shift + 1) << SUB_BUCKET_BITS) + ((value >> shift) & (sub_bucket_count - 1));
+}
+
+uint64_t MetricsRegistry::GetBucketUpperBound(size_t bucket) {
+    constexpr uint64_t sub_bucket_count = uint64_t(1) << SUB_BUCKET_BITS;
+
+    if (bucket < sub_bucket_count) {
+        return bucket;
+    }
+
+    const size_t shift = (bucket >> SUB_BUCKET_BITS) - 1;
+    const uint64_t lower_bound = (sub_bucket_count + (bucket & (sub_bucket_count - 1))) << shift;
+
+    return lower_bound + ((uint64_t(1) << shift) - 1);
+}
+
+MetricsRegistry::ThreadMetrics& MetricsRegistry::GetThreadMetrics() {
+    thread_local ThreadSlot slot;
+    return slot.Get();
+}
+
+void MetricsRegistry::Register(ThreadMetrics* thread_metrics) {
+    std::lock_guard <std::mutex> guard(mutex_);
+    threads_.push_back(thread_metrics);
+}
+
+void MetricsRegistry::Retire(ThreadMetrics* thread_metrics) {
+    std::lock_guard <std::mutex> guard(mutex_);
+    MergeInto(retired_, *thread_metrics);
+    threads_.erase(std::find(threads_.begin(), threads_.end(), thread_metrics));
+}
+
+void MetricsRegistry::MergeInto(ThreadMetrics& target, const ThreadMetrics& source) {
+    for (size_t counter = 0; counter < METRIC_COUNTER_COUNT; ++counter) {
+        AddRelaxed(target.counters[counter], source.counters[counter].load(std::memory_order_relaxed));
+    }
+
+    for (size_t histogram = 0; histogram < METRIC_HISTOGRAM_COUNT; ++histogram) {
+        for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+            AddRelaxed(target.buckets[histogram][bucket], source.buckets[histogram][bucket].load(std::memory_order_relaxed));
+        }
+
+        AddRelaxed(target.sums[histogram], source.sums[histogram].load(std::memory_order_relaxed));
+        target.maxes[histogram].store(std::max(target.maxes[histogram].load(std::memory_order_relaxed), source.maxes[histogram].load(std::memory_order_relaxed)), std::memory_order_relaxed);
+    }
+}
+
+void MetricsRegistry::Clear(ThreadMetrics& thread_metrics) {
+    for (auto& counter : thread_metrics.counters) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+
+    for (auto& buckets : thread_metrics.buckets) {
+        for (auto& bucket : buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    for (size_t histogram = 0; histogram < METRIC_HISTOGRAM_COUNT; ++histogram) {
+        thread_metrics.sums[histogram].store(0, std::memory_order_relaxed);
+        thread_metrics.maxes[histogram].store(0, std::memory_order_relaxed);
+    }
+}
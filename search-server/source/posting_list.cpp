@@ -0,0 +1,291 @@
+#include "../header/posting_list.h"
+
+size_t PostingList::size() const {
+    return size_;
+}
+
+bool PostingList::empty() const {
+    return size_ == 0;
+}
+
+size_t PostingList::CountBlockPostings(int64_t begin_id, int64_t end_id) const {
+    size_t count = 0;
+
+    const Block* const blocks = GetBlockData();
+
+    for (size_t block = FindBlock(begin_id); block < GetBlockCount() && blocks[block].first_document_id < end_id; ++block) {
+        count += blocks[block].size;
+    }
+
+    return count;
+}
+
+uint32_t PostingList::GetCount(int document_id) const {
+    const const_iterator iter = LowerBound(document_id);
+    return iter != end() && iter->document_id == document_id ? iter->count : 0;
+}
+
+void PostingList::Append(int document_id, uint32_t count) {
+    Detach();
+
+    if (blocks_.empty() || blocks_.back().size == BLOCK_SIZE) {
+        blocks_.push_back({document_id, document_id, 1, bytes_.size()});
+    } else {
+        Block& block = blocks_.back();
+
+        WriteVarint(bytes_, static_cast <uint32_t> (document_id - block.last_document_id));
+        block.last_document_id = document_id;
+        ++block.size;
+    }
+
+    WriteVarint(bytes_, count);
+    ++size_;
+}
+
+void PostingList::Insert(int document_id, uint32_t count) {
+    Detach();
+
+    if (blocks_.empty() || blocks_.back().last_document_id < document_id) {
+        Append(document_id, count);
+        return;
+    }
+
+    const size_t block = FindBlock(document_id);
+    Block& header = blocks_[block];
+
+    if (header.size == BLOCK_SIZE) {
+        std::vector <Posting> postings = DecodeBlock(block);
+
+        postings.insert(std::partition_point(postings.begin(), postings.end(), [document_id](const Posting& posting) {
+            return posting.document_id < document_id;
+        }), {document_id, count});
+
+        ReplaceBlock(block, postings);
+        ++size_;
+
+        return;
+    }
+
+    // Room left in the block: only the delta of the posting that follows changes, so the new
+    // bytes are spliced in where that delta was
+    std::vector <uint8_t> bytes;
+    size_t position = header.offset;
+    size_t replaced_size = 0;
+
+    if (document_id < header.first_document_id) {
+        WriteVarint(bytes, count);
+        WriteVarint(bytes, static_cast <uint32_t> (header.first_document_id - document_id));
+        header.first_document_id = document_id;
+    } else {
+        int previous_id = header.first_document_id;
+        ReadVarint(bytes_.data(), position);
+
+        for (;;) {
+            const size_t delta_position = position;
+            const int next_id = previous_id + static_cast <int> (ReadVarint(bytes_.data(), position));
+
+            if (next_id > document_id) {
+                WriteVarint(bytes, static_cast <uint32_t> (document_id - previous_id));
+                WriteVarint(bytes, count);
+                WriteVarint(bytes, static_cast <uint32_t> (next_id - document_id));
+                replaced_size = position - delta_position;
+                position = delta_position;
+                break;
+            }
+
+            previous_id = next_id;
+            ReadVarint(bytes_.data(), position);
+        }
+    }
+
+    bytes_.erase(bytes_.begin() + position, bytes_.begin() + position + replaced_size);
+    bytes_.insert(bytes_.begin() + position, bytes.begin(), bytes.end());
+
+    for (size_t next_block = block + 1; next_block < blocks_.size(); ++next_block) {
+        blocks_[next_block].offset += bytes.size() - replaced_size;
+    }
+
+    ++header.size;
+    ++size_;
+}
+
+bool PostingList::Erase(int document_id) {
+    Detach();
+
+    const size_t block = FindBlock(document_id);
+
+    if (block == blocks_.size()) {
+        return false;
+    }
+
+    std::vector <Posting> postings = DecodeBlock(block);
+    const auto posting_iter = std::partition_point(postings.begin(), postings.end(), [document_id](const Posting& posting) {
+        return posting.document_id < document_id;
+    });
+
+    if (posting_iter == postings.end() || posting_iter->document_id != document_id) {
+        return false;
+    }
+
+    postings.erase(posting_iter);
+    ReplaceBlock(block, postings);
+    --size_;
+
+    return true;
+}
+
+// A batch of ids above the current tail is appended; otherwise the list is re-encoded once
+void PostingList::Merge(const std::vector <Posting>& postings) {
+    if (postings.empty()) {
+        return;
+    }
+
+    Detach();
+
+    if (blocks_.empty() || blocks_.back().last_document_id < postings.front().document_id) {
+        for (const auto [document_id, count] : postings) {
+            Append(document_id, count);
+        }
+
+        return;
+    }
+
+    const std::vector <Posting> old_postings = Decode();
+    std::vector <Posting> merged_postings(old_postings.size() + postings.size());
+
+    std::merge(old_postings.begin(), old_postings.end(), postings.begin(), postings.end(), merged_postings.begin(), [](const Posting& lhs, const Posting& rhs) {
+        return lhs.document_id < rhs.document_id;
+    });
+
+    Assign(merged_postings);
+}
+
+std::vector <PostingList::Posting> PostingList::Decode() const {
+    return std::vector <Posting> (begin(), end());
+}
+
+void PostingList::Assign(const std::vector <Posting>& postings) {
+    *this = PostingList();
+
+    for (const auto [document_id, count] : postings) {
+        Append(document_id, count);
+    }
+
+    bytes_.shrink_to_fit();
+    blocks_.shrink_to_fit();
+}
+
+// Only the headers are checked, one pass over them; the bytes are read first by a query
+bool PostingList::View(const uint8_t* bytes, size_t byte_count, const Block* blocks, size_t block_count, size_t size) {
+    size_t header_size = 0;
+
+    for (size_t block = 0; block < block_count; ++block) {
+        const Block& header = blocks[block];
+        const size_t block_end = block + 1 < block_count ? blocks[block + 1].offset : byte_count;
+
+        if (header.size == 0 || header.size > BLOCK_SIZE || header.offset >= block_end || (block == 0 && header.offset != 0) || block_end > byte_count
+                || header.first_document_id < 0 || header.first_document_id > header.last_document_id
+                || static_cast <int64_t> (header.last_document_id) - header.first_document_id + 1 < header.size
+                || (block > 0 && blocks[block - 1].last_document_id >= header.first_document_id)) {
+            return false;
+        }
+
+        header_size += header.size;
+    }
+
+    if (header_size != size || (block_count == 0 && byte_count != 0)) {
+        return false;
+    }
+
+    *this = PostingList();
+    viewed_bytes_ = bytes;
+    viewed_byte_count_ = byte_count;
+    viewed_blocks_ = blocks;
+    viewed_block_count_ = block_count;
+    size_ = size;
+    is_view_ = true;
+
+    return true;
+}
+
+bool PostingList::IsView() const {
+    return is_view_;
+}
+
+size_t PostingList::GetByteSize() const {
+    return bytes_.capacity() + blocks_.capacity() * sizeof(Block);
+}
+
+size_t PostingList::GetBlockEnd(size_t block) const {
+    return block + 1 < GetBlockCount() ? GetBlockData()[block + 1].offset : GetByteCount();
+}
+
+std::vector <PostingList::Posting> PostingList::DecodeBlock(size_t block) const {
+    std::vector <Posting> postings;
+    postings.reserve(GetBlockData()[block].size);
+
+    for (const_iterator iter(this, block); iter.block_ == block; ++iter) {
+        postings.push_back(*iter);
+    }
+
+    return postings;
+}
+
+// Re-encodes one block from its new postings. A block that outgrows BLOCK_SIZE is split evenly,
+// so the halves have room for the next inserts.
+void PostingList::ReplaceBlock(size_t block, const std::vector <Posting>& postings) {
+    std::vector <uint8_t> bytes;
+    std::vector <Block> blocks;
+    const size_t offset = blocks_[block].offset;
+    const size_t block_count = (postings.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    for (size_t index = 0; index < postings.size(); ++index) {
+        const auto [document_id, count] = postings[index];
+
+        if (blocks.empty() || index == postings.size() * blocks.size() / block_count) {
+            blocks.push_back({document_id, document_id, 1, offset + bytes.size()});
+        } else {
+            WriteVarint(bytes, static_cast <uint32_t> (document_id - blocks.back().last_document_id));
+            blocks.back().last_document_id = document_id;
+            ++blocks.back().size;
+        }
+
+        WriteVarint(bytes, count);
+    }
+
+    const size_t old_end = GetBlockEnd(block);
+    const auto byte_shift = static_cast <std::ptrdiff_t> (bytes.size()) - static_cast <std::ptrdiff_t> (old_end - offset);
+
+    bytes_.erase(bytes_.begin() + offset, bytes_.begin() + old_end);
+    bytes_.insert(bytes_.begin() + offset, bytes.begin(), bytes.end());
+
+    blocks_.erase(blocks_.begin() + block);
+    blocks_.insert(blocks_.begin() + block, blocks.begin(), blocks.end());
+
+    for (size_t next_block = block + blocks.size(); next_block < blocks_.size(); ++next_block) {
+        blocks_[next_block].offset += byte_shift;
+    }
+}
+
+void PostingList::Detach() {
+    if (!is_view_) {
+        return;
+    }
+
+    bytes_.assign(viewed_bytes_, viewed_bytes_ + viewed_byte_count_);
+    blocks_.assign(viewed_blocks_, viewed_blocks_ + viewed_block_count_);
+    viewed_bytes_ = nullptr;
+    viewed_blocks_ = nullptr;
+    viewed_byte_count_ = 0;
+    viewed_block_count_ = 0;
+    is_view_ = false;
+}
+
+void PostingList::WriteVarint(std::vector <uint8_t>& bytes, uint32_t value) {
+    while (value >= 0x80) {
+        bytes.push_back(static_cast <uint8_t> (value | 0x80));
+        value >>= 7;
+    }
+
+    bytes.push_back(static_cast <uint8_t> (value));
+}
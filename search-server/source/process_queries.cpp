@@ -0,0 +1,101 @@
+#include <exception>
+
+#include "../header/process_queries.h"
+
+JoinedDocuments::Iterator::Iterator(const std::vector <std::vector <Document>>* results, size_t query_index, size_t document_index)
+    :   results_(results),
+        query_index_(query_index),
+        document_index_(document_index)
+{
+    SkipEmptyQueries();
+}
+
+JoinedDocuments::Iterator::reference JoinedDocuments::Iterator::operator* () const {
+    return (*results_)[query_index_][document_index_];
+}
+
+JoinedDocuments::Iterator::pointer JoinedDocuments::Iterator::operator-> () const {
+    return &**this;
+}
+
+JoinedDocuments::Iterator& JoinedDocuments::Iterator::operator++ () {
+    ++document_index_;
+    SkipEmptyQueries();
+
+    return *this;
+}
+
+JoinedDocuments::Iterator JoinedDocuments::Iterator::operator++ (int) {
+    Iterator previous = *this;
+    ++*this;
+
+    return previous;
+}
+
+bool JoinedDocuments::Iterator::operator== (const Iterator& other) const {
+    return results_ == other.results_ && query_index_ == other.query_index_ && document_index_ == other.document_index_;
+}
+
+bool JoinedDocuments::Iterator::operator!= (const Iterator& other) const {
+    return !(*this == other);
+}
+
+void JoinedDocuments::Iterator::SkipEmptyQueries() {
+    while (query_index_ < results_->size() && document_index_ >= (*results_)[query_index_].size()) {
+        ++query_index_;
+        document_index_ = 0;
+    }
+}
+
+JoinedDocuments::JoinedDocuments(std::vector <std::vector <Document>> results)
+    : results_(std::move(results))
+{
+    for (const std::vector <Document>& documents : results_) {
+        size_ += documents.size();
+    }
+}
+
+JoinedDocuments::Iterator JoinedDocuments::begin() const {
+    return Iterator(&results_, 0, 0);
+}
+
+JoinedDocuments::Iterator JoinedDocuments::end() const {
+    return Iterator(&results_, results_.size(), 0);
+}
+
+size_t JoinedDocuments::size() const {
+    return size_;
+}
+
+bool JoinedDocuments::empty() const {
+    return size_ == 0;
+}
+
+std::vector <std::vector <Document>> ProcessQueries(const SearchServer& search_server, const std::vector <std::string>& queries) {
+    std::vector <std::vector <Document>> results(queries.size());
+    std::vector <std::exception_ptr> errors(queries.size());
+    std::vector <size_t> indexes(queries.size());
+
+    std::iota(indexes.begin(), indexes.end(), 0);
+
+    // an exception leaving a parallel algorithm calls std::terminate, so errors are carried out by hand
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](const size_t index) {
+        try {
+            results[index] = search_server.FindTopDocuments(queries[index]);
+        } catch (...) {
+            errors[index] = std::current_exception();
+        }
+    });
+
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    return results;
+}
+
+JoinedDocuments ProcessQueriesJoined(const SearchServer& search_server, const std::vector <std::string>& queries) {
+    return JoinedDocuments(ProcessQueries(search_server, queries));
+}
@@ -1,33 +1,68 @@
-#include <iostream>
+#include <functional>
 
 #include "../header/remove_duplicates.h"
 
-void RemoveDuplicates(SearchServer& search_server) {
-    std::vector <int> id_for_remove;
-    std::map <std::set <std::string>, int> words_and_id;
+uint64_t ComputeWordSetFingerprint(const std::vector <std::string_view>& words) {
+    uint64_t fingerprint = 0xCBF29CE484222325ull ^ words.size();
 
-    for (const int id : search_server) {
-        std::set <std::string> words;
+    for (const std::string_view word : words) {
+        fingerprint = (fingerprint ^ std::hash <std::string_view> ()(word)) * 0x100000001B3ull;
+        fingerprint ^= fingerprint >> 29;
+    }
+
+    return fingerprint;
+}
+
+std::vector <int> RemoveDuplicates(SearchServer& search_server, WordSetFingerprint fingerprint) {
+    struct FingerprintedDocument {
+        uint64_t fingerprint;
+        int document_id;
+    };
+
+    const std::vector <int> document_ids(search_server.begin(), search_server.end());
+    std::vector <FingerprintedDocument> documents(document_ids.size());
+
+    std::transform(std::execution::par, document_ids.begin(), document_ids.end(), documents.begin(), [&search_server, fingerprint](const int document_id) {
+        return FingerprintedDocument{fingerprint(search_server.GetDocumentWords(document_id)), document_id};
+    });
+
+    std::sort(std::execution::par, documents.begin(), documents.end(), [](const FingerprintedDocument& lhs, const FingerprintedDocument& rhs) {
+        return lhs.fingerprint == rhs.fingerprint ? lhs.document_id < rhs.document_id : lhs.fingerprint < rhs.fingerprint;
+    });
 
-        for (const auto& [word, freq] : search_server.GetWordFrequencies(id)) {
-            words.insert(word);
+    std::vector <int> duplicate_ids;
+    std::vector <int> originals;
+
+    for (size_t group_begin = 0; group_begin < documents.size(); ) {
+        size_t group_end = group_begin + 1;
+
+        while (group_end < documents.size() && documents[group_end].fingerprint == documents[group_begin].fingerprint) {
+            ++group_end;
         }
 
-        if (words_and_id.find(words) != words_and_id.end()) {
-            if (words_and_id.at(words) > id) {
-                id_for_remove.push_back(words_and_id.at(words));
+        // ids ascend inside a group, so the first document of every distinct word set is the one kept
+        originals.clear();
 
-                std::cout << "Found duplicate document id "s << words_and_id.at(words) << std::endl;
-                words_and_id[words] = id;
-            } else {
+        for (size_t index = group_begin; index < group_end; ++index) {
+            const int document_id = documents[index].document_id;
+            const std::vector <std::string_view> words = search_server.GetDocumentWords(document_id);
+
+            const bool is_duplicate = std::any_of(originals.begin(), originals.end(), [&](const int original_id) {
+                return search_server.GetDocumentWords(original_id) == words;
+            });
 
-                std::cout << "Found duplicate document id "s << id << std::endl;
-                id_for_remove.push_back(id);
+            if (is_duplicate) {
+                duplicate_ids.push_back(document_id);
+            } else {
+                originals.push_back(document_id);
             }
-        } else {
-            words_and_id[words] = id;
         }
+
+        group_begin = group_end;
     }
 
-    std::for_each(id_for_remove.begin(), id_for_remove.end(), [&search_server] (const int id) { search_server.RemoveDocument(id); });
+    std::sort(duplicate_ids.begin(), duplicate_ids.end());
+    search_server.RemoveDocuments(duplicate_ids);
+
+    return duplicate_ids;
 }
@@ -1,26 +1,36 @@
 #include "../header/request_queue.h"
 
-RequestQueue::RequestQueue(const SearchServer &search_server)
-    : search_server_(search_server), empty_counter_(0) {}
+#include <algorithm>
 
-std::vector <Document> RequestQueue::AddFindRequest(const std::string &raw_query, DocumentStatus status) {
-    std::vector <Document> matched_documents = search_server_.FindTopDocuments(raw_query, status);
+RequestQueue::RequestQueue(const SearchServer &search_server, size_t cache_capacity, const AsyncOptions& async_options)
+    : search_server_(search_server), empty_counter_(0), cache_capacity_(cache_capacity), async_options_(async_options) {}
+
+std::vector <Document> RequestQueue::AddFindRequest(std::string_view raw_query, DocumentStatus status) {
+    const auto start = std::chrono::steady_clock::now();
+    std::vector <Document> matched_documents = FindCached(raw_query, status);
 
-    ChangeStateDeque(matched_documents);
+    ChangeStateDeque(matched_documents, std::chrono::duration <double, std::micro> (std::chrono::steady_clock::now() - start).count());
 
     return matched_documents;
 }
 
-std::vector <Document> RequestQueue::AddFindRequest(const std::string &raw_query) {
-    std::vector <Document> matched_documents = search_server_.FindTopDocuments(raw_query);
+std::vector <Document> RequestQueue::AddFindRequest(std::string_view raw_query) {
+    return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
+}
 
-    ChangeStateDeque(matched_documents);
+std::future <std::vector <Document>> RequestQueue::AddFindRequestAsync(std::string raw_query, DocumentStatus status) {
+    return Submit([this, raw_query = std::move(raw_query), status]() {
+        return FindCached(raw_query, status);
+    });
+}
 
-    return matched_documents;
+std::future <std::vector <Document>> RequestQueue::AddFindRequestAsync(std::string raw_query) {
+    return AddFindRequestAsync(std::move(raw_query), DocumentStatus::ACTUAL);
 }
 
-void RequestQueue::ChangeStateDeque(const std::vector <Document> &matched_documents) {
-    QueryResult result = { matched_documents.empty() };
+void RequestQueue::ChangeStateDeque(const std::vector <Document> &matched_documents, double latency_us) {
+    QueryResult result = { matched_documents.empty(), latency_us };
+    std::lock_guard <std::mutex> guard(requests_mutex_);
 
     empty_counter_ += result.isEmpty;
 
@@ -33,7 +43,105 @@ void RequestQueue::ChangeStateDeque(const std::vector <Document> &matched_docume
 }
 
 int RequestQueue::GetNoResultRequests() const {
+    std::lock_guard <std::mutex> guard(requests_mutex_);
     return empty_counter_;
 }
 
+// Exact percentiles over the window, taken from a copy so the lock is held only for the copy
+RequestQueue::RequestStats RequestQueue::GetRequestStats() const {
+    RequestStats stats;
+    std::vector <double> latencies;
+
+    {
+        std::lock_guard <std::mutex> guard(requests_mutex_);
+
+        stats.request_count = requests_.size();
+        stats.no_result_count = empty_counter_;
+        stats.rejected_count = rejected_counter_;
+        latencies.reserve(requests_.size());
+
+        for (const QueryResult& result : requests_) {
+            latencies.push_back(result.latency_us);
+        }
+    }
+
+    if (latencies.empty()) {
+        return stats;
+    }
+
+    auto percentile = [&latencies](double share) {
+        const auto position = latencies.begin() + std::min(latencies.size() - 1, static_cast <size_t> (share * latencies.size()));
+        std::nth_element(latencies.begin(), position, latencies.end());
+        return *position;
+    };
+
+    stats.p50_us = percentile(0.5);
+    stats.p90_us = percentile(0.9);
+    stats.p99_us = percentile(0.99);
+    stats.max_us = *std::max_element(latencies.begin(), latencies.end());
+
+    return stats;
+}
+
+RequestQueue::CacheStats RequestQueue::GetCacheStats() const {
+    std::lock_guard <std::mutex> guard(cache_mutex_);
+    return cache_stats_;
+}
+
+std::vector <Document> RequestQueue::FindCached(std::string_view raw_query, DocumentStatus status) {
+    if (cache_capacity_ == 0) {
+        return search_server_.FindTopDocuments(raw_query, status);
+    }
+
+    std::string key = search_server_.NormalizeQuery(raw_query);
+    key.push_back('\0');
+    key.push_back(static_cast <char> ('0' + static_cast <int> (status)));
+
+    const uint64_t modification_count = search_server_.GetModificationCount();
+
+    {
+        std::lock_guard <std::mutex> guard(cache_mutex_);
+        const auto index_iter = cache_index_.find(key);
+
+        if (index_iter != cache_index_.end()) {
+            const auto entry_iter = index_iter->second;
+
+            if (entry_iter->modification_count == modification_count) {
+                ++cache_stats_.hits;
+                cache_.splice(cache_.begin(), cache_, entry_iter);
 
+                return entry_iter->documents;
+            }
+
+            // written before the index last changed
+            cache_index_.erase(index_iter);
+            cache_.erase(entry_iter);
+        }
+
+        ++cache_stats_.misses;
+    }
+
+    // not under the lock: other requests keep hitting the cache meanwhile
+    std::vector <Document> matched_documents = search_server_.FindTopDocuments(raw_query, status);
+    std::lock_guard <std::mutex> guard(cache_mutex_);
+
+    // another thread may have cached the same query in the meantime
+    if (const auto index_iter = cache_index_.find(key); index_iter != cache_index_.end()) {
+        const auto entry_iter = index_iter->second;
+
+        // the index key views the entry's string, so the index goes first
+        cache_index_.erase(index_iter);
+        cache_.erase(entry_iter);
+    }
+
+    if (cache_.size() == cache_capacity_) {
+        cache_index_.erase(cache_.back().key);
+        cache_.pop_back();
+        ++cache_stats_.evictions;
+    }
+
+    cache_.push_front({std::move(key), modification_count, matched_documents});
+    cache_index_.emplace(cache_.front().key, cache_.begin());
+
+    return matched_documents;
+}
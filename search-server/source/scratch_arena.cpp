@@ -0,0 +1,80 @@
+#include "../header/scratch_arena.h"
+
+#include <algorithm>
+
+ScratchArena::Scope::Scope()
+    : arena_(ForThisThread())
+    , block_(arena_.block_)
+    , offset_(arena_.offset_)
+{
+    ++arena_.scope_depth_;
+}
+
+ScratchArena::Scope::~Scope() {
+    arena_.block_ = block_;
+    arena_.offset_ = offset_;
+
+    if (--arena_.scope_depth_ == 0 && arena_.blocks_.size() > 1) {
+        arena_.MergeBlocks();
+    }
+}
+
+std::pmr::memory_resource* ScratchArena::Scope::GetResource() const {
+    return &arena_;
+}
+
+ScratchArena& ScratchArena::ForThisThread() {
+    static thread_local ScratchArena arena;
+    return arena;
+}
+
+size_t ScratchArena::GetCapacity() const {
+    size_t capacity = 0;
+
+    for (const Block& block : blocks_) {
+        capacity += block.size;
+    }
+
+    return capacity;
+}
+
+uint64_t ScratchArena::GetBlockAllocationCount() const {
+    return block_allocation_count_;
+}
+
+// Bumps through the current block, then through the blocks after it; a request none of them fits gets a new block
+void* ScratchArena::do_allocate(size_t bytes, size_t alignment) {
+    for (; block_ < blocks_.size(); ++block_, offset_ = 0) {
+        const auto address = reinterpret_cast <uintptr_t> (blocks_[block_].data.get());
+        const size_t aligned_offset = (address + offset_ + alignment - 1) / alignment * alignment - address;
+
+        if (aligned_offset + bytes <= blocks_[block_].size) {
+            offset_ = aligned_offset + bytes;
+            return blocks_[block_].data.get() + aligned_offset;
+        }
+    }
+
+    AddBlock(std::max({MIN_BLOCK_SIZE, bytes + alignment, blocks_.empty() ? 0 : blocks_.back().size * 2}));
+    block_ = blocks_.size() - 1;
+
+    return do_allocate(bytes, alignment);
+}
+
+bool ScratchArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+void ScratchArena::AddBlock(size_t size) {
+    blocks_.push_back({std::unique_ptr <std::byte[]> (new std::byte[size]), size});
+    ++block_allocation_count_;
+}
+
+// Only called with nothing allocated, so the blocks can simply be replaced
+void ScratchArena::MergeBlocks() {
+    const size_t capacity = GetCapacity();
+
+    blocks_.clear();
+    AddBlock(capacity);
+    block_ = 0;
+    offset_ = 0;
+}
@@ -1,200 +1,771 @@
 #include "../header/search_server.h"
 
-SearchServer::SearchServer(const std::string& text) {
-    for (const std::string& word : SplitIntoWords(text)) {
-        if (!SearchServer::IsValidWord(word)) {
-            throw std::invalid_argument("invalid stop word"s);
-        }
+#include <atomic>
 
-        if (!word.empty()) {
-            stop_words_.insert(word);
-        }
+SearchServer::SearchServer(const std::string& text)
+    : SearchServer(std::string_view(text))
+{}
+
+SearchServer::SearchServer(std::string_view text) {
+    const TokenizedText tokens = TokenizeText(text);
+
+    if (tokens.has_control_characters) {
+        throw std::invalid_argument("invalid stop word"s);
+    }
+
+    for (const std::string_view word : tokens.words) {
+        stop_words_.emplace(word);
     }
 }
 
-void SearchServer::AddDocument(int document_id, const std::string& document, DocumentStatus status, const std::vector <int>& ratings) {
+void SearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector <int>& ratings) {
     if (document_id < 0) {
         throw std::invalid_argument("invalid id"s);
     }
 
-    if (std::find(id_base_.begin(), id_base_.end(), document_id) != id_base_.end()) {
+    if (documents_.FindLive(document_id) != DocumentTable::NO_ORDINAL) {
         throw std::invalid_argument("id duplication"s);
     }
 
-    const std::vector <std::string> words = SplitIntoWordsNoStop(document);
-    const double inv_word_count = 1.0 / words.size();
+    ScratchArena::Scope scratch;
+    // stop words never hold control characters, so checking the whole text checks the remaining words
+    const TokenizedText tokens = TokenizeNoStop(document, scratch.GetResource());
+
+    if (tokens.has_control_characters) {
+        throw std::invalid_argument("invalid document word"s);
+    }
+
+    const std::pmr::vector <std::string_view>& words = tokens.words;
+
+    if (IsRemoved(document_id)) {
+        PurgeRemovedDocument(document_id);
+    }
+
+    std::pmr::map <std::string_view, uint32_t> word_counts(scratch.GetResource());
+
+    for (const std::string_view word : words) {
+        ++word_counts[word];
+    }
+
+    const auto word_count = static_cast <uint32_t> (words.size());
+    std::vector <uint32_t> term_ids;
+    term_ids.reserve(word_counts.size());
+
+    for (const auto [word, _] : word_counts) {
+        term_ids.push_back(terms_.Intern(word));
+    }
+
+    postings_.resize(terms_.size());
+    document_freqs_.resize(terms_.size());
+    log_document_freqs_.resize(terms_.size());
+    max_term_freqs_.resize(terms_.size());
+
+    auto term_id_iter = term_ids.begin();
+
+    for (const auto [_, count] : word_counts) {
+        const uint32_t term_id = *term_id_iter++;
+
+        postings_[term_id].Insert(document_id, count);
+        log_document_freqs_[term_id] = std::log(++document_freqs_[term_id]);
+        max_term_freqs_[term_id] = std::max(max_term_freqs_[term_id], ComputeTermFreq(count, word_count));
+    }
+
+    documents_.Add(document_id, ComputeAverageRating(ratings), status, word_count, std::move(term_ids));
+    log_document_count_ = std::log(documents_.GetLiveCount());
+    MarkModified();
+}
+
+std::vector <DocumentError> SearchServer::AddDocuments(const std::vector <DocumentRecord>& documents) {
+    std::vector <size_t> candidates;
+
+    for (size_t index = 0; index < documents.size(); ++index) {
+        if (documents[index].id >= 0 && documents_.FindLive(documents[index].id) == DocumentTable::NO_ORDINAL) {
+            candidates.push_back(index);
+        }
+    }
+
+    std::vector <PartialIndex> partial_indexes = PrepareDocuments(documents, candidates);
 
-    for (const std::string& word : words) {
-        if (!SearchServer::IsValidWord(word)) {
-            throw std::invalid_argument("invalid document word"s);
+    return CommitDocuments(documents, partial_indexes);
+}
+
+std::vector <SearchServer::PartialIndex> SearchServer::PrepareDocuments(const std::vector <DocumentRecord>& documents, const std::vector <size_t>& candidates) const {
+    const size_t worker_count = std::min <size_t> (std::max(1u, std::thread::hardware_concurrency()) * 4, (candidates.size() + 255) / 256);
+    std::vector <PartialIndex> partial_indexes(worker_count);
+    std::vector <size_t> workers(worker_count);
+
+    std::iota(workers.begin(), workers.end(), 0);
+
+    std::for_each(std::execution::par, workers.begin(), workers.end(), [&](const size_t worker) {
+        const std::vector <size_t> share(candidates.begin() + candidates.size() * worker / worker_count, candidates.begin() + candidates.size() * (worker + 1) / worker_count);
+        BuildPartialIndex(documents, share, partial_indexes[worker]);
+    });
+
+    return partial_indexes;
+}
+
+// Tokenizing is done; only the merge into the index is left
+std::vector <DocumentError> SearchServer::CommitDocuments(const std::vector <DocumentRecord>& documents, std::vector <PartialIndex>& partial_indexes) {
+    std::vector <bool> has_invalid_word(documents.size(), false);
+
+    for (const PartialIndex& partial_index : partial_indexes) {
+        for (const size_t index : partial_index.invalid_documents) {
+            has_invalid_word[index] = true;
         }
+    }
+
+    // decided in batch order with the same checks AddDocument makes, so the outcome matches a loop of AddDocument calls
+    std::vector <DocumentError> errors;
+    std::vector <bool> accepted(documents.size(), false);
+    std::unordered_set <int> batch_ids;
+
+    for (size_t index = 0; index < documents.size(); ++index) {
+        const int document_id = documents[index].id;
+
+        if (document_id < 0) {
+            errors.push_back({index, document_id, "invalid id"s});
+        } else if (documents_.FindLive(document_id) != DocumentTable::NO_ORDINAL || batch_ids.count(document_id) > 0) {
+            errors.push_back({index, document_id, "id duplication"s});
+        } else if (has_invalid_word[index]) {
+            errors.push_back({index, document_id, "invalid document word"s});
+        } else {
+            accepted[index] = true;
+            batch_ids.insert(document_id);
+        }
+    }
 
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        word_freqs_ids_[document_id][word] += inv_word_count;
+    if (batch_ids.empty()) {
+        return errors;
+    }
+
+    for (const int document_id : batch_ids) {
+        if (IsRemoved(document_id)) {
+            PurgeRemovedDocument(document_id);
+        }
     }
 
-    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
-    id_base_.insert(document_id);
+    struct TermBatch {
+        uint32_t term_id;
+        double max_term_freq;
+        std::vector <PostingList::Posting> postings;
+    };
+
+    // the batch's postings of every touched term, merged into the compressed lists at the end
+    std::vector <TermBatch> term_batches;
+    std::unordered_map <uint32_t, size_t> term_batch_indexes;
+    std::vector <PostingList::Posting> accepted_postings;
+
+    for (PartialIndex& partial_index : partial_indexes) {
+        std::vector <uint32_t> global_ids(partial_index.words.size(), TermDictionary::NO_TERM);
+
+        for (uint32_t local_id = 0; local_id < partial_index.words.size(); ++local_id) {
+            double max_term_freq = 0.0;
+            accepted_postings.clear();
+
+            for (const auto [index, count, word_count] : partial_index.postings[local_id]) {
+                if (accepted[index]) {
+                    accepted_postings.push_back({documents[index].id, count});
+                    max_term_freq = std::max(max_term_freq, ComputeTermFreq(count, word_count));
+                }
+            }
+
+            // a word only rejected documents have never reaches the dictionary
+            if (accepted_postings.empty()) {
+                continue;
+            }
+
+            const uint32_t term_id = terms_.Intern(partial_index.words[local_id]);
+            global_ids[local_id] = term_id;
+
+            const auto [batch_index_iter, is_new_term] = term_batch_indexes.emplace(term_id, term_batches.size());
+
+            if (is_new_term) {
+                term_batches.push_back({term_id, 0.0, {}});
+            }
+
+            TermBatch& term_batch = term_batches[batch_index_iter->second];
+            term_batch.postings.insert(term_batch.postings.end(), accepted_postings.begin(), accepted_postings.end());
+            term_batch.max_term_freq = std::max(term_batch.max_term_freq, max_term_freq);
+        }
+
+        for (const PartialIndex::IndexedDocument& indexed_document : partial_index.documents) {
+            if (!accepted[indexed_document.index]) {
+                continue;
+            }
+
+            const DocumentRecord& record = documents[indexed_document.index];
+            std::vector <uint32_t> term_ids;
+            term_ids.reserve(indexed_document.term_ids.size());
+
+            for (const uint32_t local_id : indexed_document.term_ids) {
+                term_ids.push_back(global_ids[local_id]);
+            }
+
+            documents_.Add(record.id, ComputeAverageRating(record.ratings), record.status, indexed_document.word_count, std::move(term_ids));
+        }
+
+        partial_index = {};
+    }
+
+    postings_.resize(terms_.size());
+    document_freqs_.resize(terms_.size());
+    log_document_freqs_.resize(terms_.size());
+    max_term_freqs_.resize(terms_.size());
+
+    std::for_each(std::execution::par, term_batches.begin(), term_batches.end(), [this](TermBatch& term_batch) {
+        const uint32_t term_id = term_batch.term_id;
+        std::vector <PostingList::Posting>& term_postings = term_batch.postings;
+
+        std::sort(term_postings.begin(), term_postings.end(), [](const PostingList::Posting& lhs, const PostingList::Posting& rhs) {
+            return lhs.document_id < rhs.document_id;
+        });
+
+        postings_[term_id].Merge(term_postings);
+        document_freqs_[term_id] += term_postings.size();
+        log_document_freqs_[term_id] = std::log(document_freqs_[term_id]);
+        max_term_freqs_[term_id] = std::max(max_term_freqs_[term_id], term_batch.max_term_freq);
+
+        std::vector <PostingList::Posting> ().swap(term_postings);
+    });
+
+    log_document_count_ = std::log(documents_.GetLiveCount());
+    MarkModified();
+
+    return errors;
 }
 
+void SearchServer::BuildPartialIndex(const std::vector <DocumentRecord>& documents, const std::vector <size_t>& indexes, PartialIndex& partial_index) const {
+    for (const size_t index : indexes) {
+        ScratchArena::Scope scratch;
+        const TokenizedText tokens = TokenizeNoStop(documents[index].text, scratch.GetResource());
+        const std::pmr::vector <std::string_view>& words = tokens.words;
+
+        if (tokens.has_control_characters) {
+            partial_index.invalid_documents.push_back(index);
+            continue;
+        }
+
+        std::pmr::map <std::string_view, uint32_t> word_counts(scratch.GetResource());
+
+        for (const std::string_view word : words) {
+            ++word_counts[word];
+        }
+
+        PartialIndex::IndexedDocument indexed_document{index, static_cast <uint32_t> (words.size()), {}};
+        indexed_document.term_ids.reserve(word_counts.size());
+
+        for (const auto [word, count] : word_counts) {
+            const auto [term_iter, inserted] = partial_index.term_ids.emplace(word, static_cast <uint32_t> (partial_index.words.size()));
+
+            if (inserted) {
+                partial_index.words.push_back(word);
+                partial_index.postings.emplace_back();
+            }
+
+            partial_index.postings[term_iter->second].push_back({index, count, indexed_document.word_count});
+            indexed_document.term_ids.push_back(term_iter->second);
+        }
+
+        partial_index.documents.push_back(std::move(indexed_document));
+    }
+}
 
 void SearchServer::RemoveDocument(int document_id) {
-    std::set <int>::iterator id_iter = id_base_.find(document_id);
+    const uint32_t ordinal = documents_.FindLive(document_id);
+
+    if (ordinal == DocumentTable::NO_ORDINAL) {
+        return;
+    }
+
+    MarkRemoved(ordinal);
+    log_document_count_ = std::log(documents_.GetLiveCount());
+    MarkModified();
+}
+
+void SearchServer::RemoveDocuments(const std::vector <int>& document_ids) {
+    bool is_changed = false;
 
-    if (id_iter != id_base_.end()) {
-        for (const auto [word, _other] : GetWordFrequencies(document_id)) {
-            word_to_document_freqs_[word].erase(document_id);
+    for (const int document_id : document_ids) {
+        if (const uint32_t ordinal = documents_.FindLive(document_id); ordinal != DocumentTable::NO_ORDINAL) {
+            MarkRemoved(ordinal);
+            is_changed = true;
         }
+    }
 
-        id_base_.erase(id_iter);
-        word_freqs_ids_.erase(document_id);
-        documents_.erase(document_id);
+    if (is_changed) {
+        log_document_count_ = std::log(documents_.GetLiveCount());
+        MarkModified();
     }
 }
 
-std::vector <Document> SearchServer::FindTopDocuments(const std::string& raw_query, DocumentStatus status) const {
-    for (const std::string& word : SplitIntoWords(raw_query)) {
-        if (!SearchServer::IsValidWord(word)) {
-            throw std::invalid_argument("invalid query word"s);
+/*
+ * Dead postings are filtered out of every list in parallel. If some terms are left without
+ * postings, the surviving ones get a fresh dense dictionary and the forward lists are renumbered.
+ */
+CompactionStats SearchServer::Compact() {
+    CompactionStats stats;
+
+    if (removed_posting_count_ == 0 && std::find(document_freqs_.begin(), document_freqs_.end(), 0u) == document_freqs_.end()) {
+        return stats;
+    }
+
+    const size_t byte_size_before = GetIndexByteSize();
+
+    std::for_each(std::execution::par, postings_.begin(), postings_.end(), [this](PostingList& postings) {
+        postings.RemoveIf([this](const PostingList::Posting& posting) {
+            return IsRemoved(posting.document_id);
+        });
+    });
+
+    stats.removed_postings = removed_posting_count_;
+    removed_posting_count_ = 0;
+    documents_.Compact();
+
+    const size_t live_term_count = postings_.size() - std::count(document_freqs_.begin(), document_freqs_.end(), 0u);
+
+    if (live_term_count < terms_.size()) {
+        TermDictionary terms;
+        std::vector <uint32_t> new_term_ids(terms_.size(), TermDictionary::NO_TERM);
+        std::vector <PostingList> postings;
+        std::vector <uint32_t> document_freqs;
+        std::vector <double> log_document_freqs;
+        std::vector <double> max_term_freqs;
+
+        postings.reserve(live_term_count);
+        document_freqs.reserve(live_term_count);
+        log_document_freqs.reserve(live_term_count);
+        max_term_freqs.reserve(live_term_count);
+
+        for (uint32_t term_id = 0; term_id < terms_.size(); ++term_id) {
+            if (document_freqs_[term_id] == 0) {
+                continue;
+            }
+
+            new_term_ids[term_id] = terms.Intern(terms_.GetWord(term_id));
+            postings.push_back(std::move(postings_[term_id]));
+            document_freqs.push_back(document_freqs_[term_id]);
+            log_document_freqs.push_back(log_document_freqs_[term_id]);
+            max_term_freqs.push_back(max_term_freqs_[term_id]);
         }
+
+        // surviving terms keep their relative order, so the forward lists stay in word order
+        documents_.RenumberTerms(new_term_ids);
+
+        stats.removed_terms = terms_.size() - terms.size();
+        terms_ = std::move(terms);
+        postings_ = std::move(postings);
+        document_freqs_ = std::move(document_freqs);
+        log_document_freqs_ = std::move(log_document_freqs);
+        max_term_freqs_ = std::move(max_term_freqs);
+        // term ids moved: prepared queries must look their words up again
+        index_version_ = NextIndexVersion();
     }
 
-    auto find_lambda = [&status](int document_id, DocumentStatus doc_status, int rating) {
-        return status == doc_status;
-    };
+    const size_t byte_size_after = GetIndexByteSize();
+    stats.bytes_reclaimed = byte_size_before > byte_size_after ? byte_size_before - byte_size_after : 0;
 
-    return FindTopDocuments(raw_query, find_lambda);
+    return stats;
 }
 
-std::vector <Document> SearchServer::FindTopDocuments(const std::string& raw_query) const {
-    for (const std::string& word : SplitIntoWords(raw_query)) {
-        if (!SearchServer::IsValidWord(word)) {
-            throw std::invalid_argument("invalid query word"s);
-        }
+size_t SearchServer::GetRemovedPostingCount() const {
+    return removed_posting_count_;
+}
+
+std::vector <Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status, const SearchOptions& options) const {
+    return FindTopDocuments(std::execution::seq, raw_query, status, options);
+}
+
+std::vector <Document> SearchServer::FindTopDocuments(std::string_view raw_query, const SearchOptions& options) const {
+    return FindTopDocuments(std::execution::seq, raw_query, options);
+}
+
+PreparedQuery SearchServer::Prepare(std::string_view raw_query) const {
+    ScratchArena::Scope scratch;
+    const Query query = ParseQuery(raw_query, scratch.GetResource());
+    PreparedQuery prepared_query;
+
+    prepared_query.plus_words_.assign(query.plus_words.begin(), query.plus_words.end());
+    prepared_query.minus_words_.assign(query.minus_words.begin(), query.minus_words.end());
+    prepared_query.index_version_ = index_version_;
+
+    for (const std::string_view word : query.plus_words) {
+        const uint32_t term_id = terms_.Find(word);
+        const bool is_live = term_id != TermDictionary::NO_TERM && document_freqs_[term_id] > 0;
+
+        prepared_query.plus_term_ids_.push_back(term_id);
+        // never read for a word no live document has
+        prepared_query.inverse_document_freqs_.push_back(is_live ? ComputeWordInverseDocumentFreq(term_id) : 0.0);
     }
 
-    auto find_lambda = [](int document_id, DocumentStatus doc_status, int rating) {
-        return  doc_status == DocumentStatus::ACTUAL;
-    };
+    for (const std::string_view word : query.minus_words) {
+        prepared_query.minus_term_ids_.push_back(terms_.Find(word));
+    }
 
-    return FindTopDocuments(raw_query, find_lambda);
+    return prepared_query;
+}
+
+std::vector <Document> SearchServer::FindTopDocuments(const PreparedQuery& query, DocumentStatus status, const SearchOptions& options) const {
+    return FindTopDocuments(std::execution::seq, query, status, options);
+}
+
+std::vector <Document> SearchServer::FindTopDocuments(const PreparedQuery& query, const SearchOptions& options) const {
+    return FindTopDocuments(std::execution::seq, query, options);
 }
 
 int SearchServer::GetDocumentCount() const {
-    return documents_.size();
+    return documents_.GetLiveCount();
 }
 
-const std::map <std::string, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    static const std::map <std::string, double> res;
-    return word_freqs_ids_.count(document_id) ? word_freqs_ids_.at(document_id) : res;
+uint64_t SearchServer::GetModificationCount() const {
+    return modification_count_;
 }
 
-std::set <int> ::const_iterator SearchServer::begin() {
-    return id_base_.begin();
+std::map <std::string_view, double> SearchServer::GetWordFrequencies(int document_id) const {
+    std::map <std::string_view, double> word_freqs;
+    const uint32_t ordinal = documents_.FindLive(document_id);
+
+    if (ordinal == DocumentTable::NO_ORDINAL) {
+        return word_freqs;
+    }
+
+    for (const uint32_t term_id : documents_.GetTermIds(ordinal)) {
+        const uint32_t count = postings_[term_id].GetCount(document_id);
+        word_freqs.emplace_hint(word_freqs.end(), terms_.GetWord(term_id), ComputeTermFreq(count, documents_.GetWordCount(ordinal)));
+    }
+
+    return word_freqs;
 }
 
-std::set <int> ::const_iterator SearchServer::end() {
-    return id_base_.end();
+std::vector <std::string_view> SearchServer::GetDocumentWords(int document_id) const {
+    std::vector <std::string_view> words;
+    const uint32_t ordinal = documents_.FindLive(document_id);
+
+    if (ordinal == DocumentTable::NO_ORDINAL) {
+        return words;
+    }
+
+    words.reserve(documents_.GetTermIds(ordinal).size());
+
+    for (const uint32_t term_id : documents_.GetTermIds(ordinal)) {
+        words.push_back(terms_.GetWord(term_id));
+    }
+
+    return words;
 }
 
-std::tuple <std::vector <std::string>, DocumentStatus> SearchServer::MatchDocument(const std::string& raw_query, int document_id) const {
-    for (const std::string& word : SplitIntoWords(raw_query)) {
-        if (!SearchServer::IsValidWord(word)) {
-            throw std::invalid_argument("invalid query word"s);
-        }
+// Containers report capacities; whatever views a loaded snapshot is in the mapping, not on the heap
+size_t SearchServer::GetIndexByteSize() const {
+    size_t byte_size = postings_.capacity() * sizeof(PostingList)
+        + document_freqs_.capacity() * sizeof(uint32_t)
+        + log_document_freqs_.capacity() * sizeof(double)
+        + max_term_freqs_.capacity() * sizeof(double)
+        + terms_.GetByteSize()
+        + documents_.GetByteSize();
+
+    for (const PostingList& postings : postings_) {
+        byte_size += postings.GetByteSize();
     }
 
-    const Query query = ParseQuery(raw_query);
-    std::vector <std::string> matched_words;
+    return byte_size;
+}
 
-    for (const std::string& word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
+DocumentTable::LiveIdIterator SearchServer::begin() {
+    return documents_.begin();
+}
 
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(word);
+DocumentTable::LiveIdIterator SearchServer::end() {
+    return documents_.end();
+}
+
+std::tuple <std::vector <std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
+    return MatchDocument(std::execution::seq, raw_query, document_id);
+}
+
+std::tuple <std::vector <std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::sequenced_policy& policy, std::string_view raw_query, int document_id) const {
+    ScratchArena::Scope scratch;
+    return MatchQuery(policy, ParseQuery(raw_query, scratch.GetResource()), document_id);
+}
+
+std::tuple <std::vector <std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::parallel_policy& policy, std::string_view raw_query, int document_id) const {
+    ScratchArena::Scope scratch;
+    return MatchQuery(policy, ParseQuery(raw_query, scratch.GetResource()), document_id);
+}
+
+std::tuple <std::vector <std::string_view>, DocumentStatus> SearchServer::MatchDocument(const PreparedQuery& query, int document_id) const {
+    return MatchDocument(std::execution::seq, query, document_id);
+}
+
+std::tuple <std::vector <std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::sequenced_policy& policy, const PreparedQuery& query, int document_id) const {
+    ScratchArena::Scope scratch;
+    return MatchQuery(policy, ViewQuery(query, scratch.GetResource()), document_id);
+}
+
+std::tuple <std::vector <std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::parallel_policy& policy, const PreparedQuery& query, int document_id) const {
+    ScratchArena::Scope scratch;
+    return MatchQuery(policy, ViewQuery(query, scratch.GetResource()), document_id);
+}
+
+// Query words and the document's terms are both in word order, so every lookup resumes where the previous one stopped
+std::tuple <std::vector <std::string_view>, DocumentStatus> SearchServer::MatchQuery(const std::execution::sequenced_policy&, const Query& query, int document_id) const {
+    const uint32_t ordinal = FindMatchedDocument(document_id);
+    const DocumentTable::TermIdSpan term_ids = documents_.GetTermIds(ordinal);
+
+    for (const std::string_view word : query.minus_words) {
+        if (!FindDocumentWord(ordinal, word).empty()) {
+            return {std::vector <std::string_view> (), documents_.GetStatus(ordinal)};
         }
     }
 
-    for (const std::string& word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
+    std::vector <std::string_view> matched_words;
+    auto term_iter = term_ids.begin();
 
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.clear();
+    for (const std::string_view word : query.plus_words) {
+        term_iter = std::lower_bound(term_iter, term_ids.end(), word, [this](const uint32_t term_id, std::string_view query_word) {
+            return terms_.GetWord(term_id) < query_word;
+        });
+
+        if (term_iter == term_ids.end()) {
             break;
         }
+
+        if (terms_.GetWord(*term_iter) == word) {
+            matched_words.push_back(terms_.GetWord(*term_iter));
+        }
+    }
+
+    return {matched_words, documents_.GetStatus(ordinal)};
+}
+
+std::tuple <std::vector <std::string_view>, DocumentStatus> SearchServer::MatchQuery(const std::execution::parallel_policy&, const Query& query, int document_id) const {
+    const uint32_t ordinal = FindMatchedDocument(document_id);
+
+    auto find_document_word = [this, ordinal](const std::string_view word) {
+        return FindDocumentWord(ordinal, word);
+    };
+
+    if (std::any_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(), [&find_document_word](const std::string_view word) {
+        return !find_document_word(word).empty();
+    })) {
+        return {std::vector <std::string_view> (), documents_.GetStatus(ordinal)};
     }
 
-    return {matched_words, documents_.at(document_id).status};
+    // the plus words are already sorted and unique, so compacting the hits keeps that order
+    std::vector <std::string_view> matched_words(query.plus_words.size());
+    std::transform(std::execution::par, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), find_document_word);
+    matched_words.erase(std::remove_if(matched_words.begin(), matched_words.end(), [](const std::string_view word) { return word.empty(); }), matched_words.end());
+
+    return {matched_words, documents_.GetStatus(ordinal)};
 }
 
-bool SearchServer::IsStopWord(const std::string& word) const {
+std::string SearchServer::NormalizeQuery(std::string_view raw_query) const {
+    ScratchArena::Scope scratch;
+    const Query query = ParseQuery(raw_query, scratch.GetResource());
+    std::string normalized_query;
+
+    for (const std::string_view word : query.plus_words) {
+        normalized_query.append(word).push_back(' ');
+    }
+
+    for (const std::string_view word : query.minus_words) {
+        normalized_query.append("-"s).append(word).push_back(' ');
+    }
+
+    if (!normalized_query.empty()) {
+        normalized_query.pop_back();
+    }
+
+    return normalized_query;
+}
+
+// Starts at 1: a PreparedQuery at 0 was never resolved
+uint64_t SearchServer::NextIndexVersion() {
+    static std::atomic <uint64_t> next_version{1};
+    return next_version.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SearchServer::MarkModified() {
+    ++modification_count_;
+    index_version_ = NextIndexVersion();
+}
+
+bool SearchServer::IsStopWord(std::string_view word) const {
     return stop_words_.count(word) > 0;
 }
 
-bool SearchServer::IsValidWord(const std::string& word) {
-    return none_of(word.begin(), word.end(), [](char c) { return c >= '\0' && c < ' '; });
+bool SearchServer::IsValidWord(std::string_view word) {
+    return !HasControlCharacters(word);
 }
 
 int SearchServer::ComputeAverageRating(const std::vector <int>& ratings) {
     return ratings.empty() ? 0 : std::accumulate(ratings.begin(), ratings.end(), 0) / static_cast <int>(ratings.size());
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string& word) const {
-    return std::log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+// log(N / df) as log(N) - log(df): both logs are refreshed by the writes that change them,
+// so a query pays two loads instead of a division and a log per term
+double SearchServer::ComputeWordInverseDocumentFreq(uint32_t term_id) const {
+    return log_document_count_ - log_document_freqs_[term_id];
 }
 
-std::vector <std::string> SearchServer::SplitIntoWordsNoStop(const std::string& text) const {
-    std::vector <std::string> words;
+// Live documents containing the word; 0 for a word the server has never seen
+uint32_t SearchServer::GetDocumentFreq(std::string_view word) const {
+    const uint32_t term_id = terms_.Find(word);
+    return term_id == TermDictionary::NO_TERM ? 0 : document_freqs_[term_id];
+}
+
+bool SearchServer::IsRemoved(int document_id) const {
+    const uint32_t ordinal = documents_.Find(document_id);
+    return ordinal != DocumentTable::NO_ORDINAL && !documents_.IsLive(ordinal);
+}
 
-    for (const std::string& word : SplitIntoWords(text)) {
-        if (!IsStopWord(word)) words.push_back(word);
+// Takes the document out of every lookup structure; only its postings and its table row are left behind
+void SearchServer::MarkRemoved(uint32_t ordinal) {
+    const DocumentTable::TermIdSpan term_ids = documents_.GetTermIds(ordinal);
+
+    for (const uint32_t term_id : term_ids) {
+        log_document_freqs_[term_id] = std::log(--document_freqs_[term_id]);
     }
 
-    return words;
+    removed_posting_count_ += term_ids.size();
+    documents_.MarkRemoved(ordinal);
+}
+
+// An id is about to be reused: its dead postings must go first, or a list would hold it twice
+void SearchServer::PurgeRemovedDocument(int document_id) {
+    const DocumentTable::TermIdSpan term_ids = documents_.GetTermIds(documents_.Find(document_id));
+
+    for (const uint32_t term_id : term_ids) {
+        postings_[term_id].Erase(document_id);
+    }
+
+    removed_posting_count_ -= term_ids.size();
+    documents_.Release(document_id);
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(const std::string& text) const {
+uint32_t SearchServer::FindMatchedDocument(int document_id) const {
+    const uint32_t ordinal = documents_.FindLive(document_id);
+
+    if (ordinal == DocumentTable::NO_ORDINAL) {
+        throw std::out_of_range("unknown document id"s);
+    }
+
+    return ordinal;
+}
+
+bool SearchServer::OfferTopDocument(std::vector <Document>& top_documents, const Document& document, size_t max_count) {
+    if (top_documents.size() < max_count) {
+        top_documents.push_back(document);
+        std::push_heap(top_documents.begin(), top_documents.end(), MoreRelevant());
+    } else if (MoreRelevant()(document, top_documents.front())) {
+        std::pop_heap(top_documents.begin(), top_documents.end(), MoreRelevant());
+        top_documents.back() = document;
+        std::push_heap(top_documents.begin(), top_documents.end(), MoreRelevant());
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+const PostingList* SearchServer::FindPostings(std::string_view word) const {
+    const uint32_t term_id = terms_.Find(word);
+    return term_id == TermDictionary::NO_TERM ? nullptr : &postings_[term_id];
+}
+
+// The dictionary's copy of the word if the document contains it, an empty view otherwise
+std::string_view SearchServer::FindDocumentWord(uint32_t ordinal, std::string_view word) const {
+    const DocumentTable::TermIdSpan term_ids = documents_.GetTermIds(ordinal);
+    const auto term_iter = std::lower_bound(term_ids.begin(), term_ids.end(), word, [this](const uint32_t term_id, std::string_view query_word) {
+        return terms_.GetWord(term_id) < query_word;
+    });
+
+    return term_iter != term_ids.end() && terms_.GetWord(*term_iter) == word ? terms_.GetWord(*term_iter) : std::string_view();
+}
+
+TokenizedText SearchServer::TokenizeNoStop(std::string_view text, std::pmr::memory_resource* resource) const {
+    TokenizedText tokens = TokenizeText(text, resource);
+
+    if (!stop_words_.empty()) {
+        tokens.words.erase(std::remove_if(tokens.words.begin(), tokens.words.end(), [this](const std::string_view word) {
+            return IsStopWord(word);
+        }), tokens.words.end());
+    }
+
+    return tokens;
+}
+
+SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) const {
     if (text.empty()) {
         throw std::invalid_argument("Query word is empty"s);
     }
 
     bool is_minus = false;
-    std::string word = text;
+    std::string_view word = text;
 
     if (word[0] == '-') {
         is_minus = true;
-        word = word.substr(1);
+        word.remove_prefix(1);
     }
 
-    if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
-        throw std::invalid_argument("Query word "s + text + " is invalid");
+    if (word.empty() || word[0] == '-') {
+        throw std::invalid_argument("Query word "s + std::string(text) + " is invalid");
     }
 
     return {word, is_minus, IsStopWord(word)};
 }
 
-SearchServer::Query SearchServer::ParseQuery(const std::string& text) const {
-    Query query;
+SearchServer::Query SearchServer::ParseQuery(std::string_view text, std::pmr::memory_resource* resource) const {
+    METRICS_SCOPED_TIMER(MetricHistogram::QUERY_PARSE);
+    Query query{std::pmr::vector <std::string_view> (resource), std::pmr::vector <std::string_view> (resource)};
+    TokenizedText tokens{std::pmr::vector <std::string_view> (resource)};
+
+    {
+        // the words are checked in the same pass that splits them, so validation is that pass
+        METRICS_SCOPED_TIMER(MetricHistogram::QUERY_VALIDATION);
+        tokens = TokenizeText(text, resource);
+
+        if (tokens.has_control_characters) {
+            throw std::invalid_argument("invalid query word"s);
+        }
+    }
 
-    for (const std::string& word : SplitIntoWords(text)) {
+    for (const std::string_view word : tokens.words) {
         const QueryWord query_word = ParseQueryWord(word);
 
         if (!query_word.is_stop) {
             if (query_word.is_minus) {
-                query.minus_words.insert(query_word.data);
+                query.minus_words.push_back(query_word.data);
             } else {
-                query.plus_words.insert(query_word.data);
+                query.plus_words.push_back(query_word.data);
             }
         }
     }
 
+    for (std::pmr::vector <std::string_view>* words : {&query.plus_words, &query.minus_words}) {
+        std::sort(words->begin(), words->end());
+        words->erase(std::unique(words->begin(), words->end()), words->end());
+    }
+
+    return query;
+}
+
+SearchServer::Query SearchServer::ViewQuery(const PreparedQuery& prepared_query, std::pmr::memory_resource* resource) const {
+    Query query{std::pmr::vector <std::string_view> (resource), std::pmr::vector <std::string_view> (resource)};
+
+    query.plus_words.assign(prepared_query.plus_words_.begin(), prepared_query.plus_words_.end());
+    query.minus_words.assign(prepared_query.minus_words_.begin(), prepared_query.minus_words_.end());
+
+    if (prepared_query.index_version_ == index_version_) {
+        query.plus_term_ids = &prepared_query.plus_term_ids_;
+        query.minus_term_ids = &prepared_query.minus_term_ids_;
+    }
+
     return query;
 }
 
-void AddDocument(SearchServer& search_server, int document_id, const std::string& document, DocumentStatus status, const std::vector<int>& ratings) {
+const std::vector <double>* SearchServer::GetPreparedInverseDocumentFreqs(const PreparedQuery& prepared_query) const {
+    return prepared_query.index_version_ == index_version_ ? &prepared_query.inverse_document_freqs_ : nullptr;
+}
+
+void AddDocument(SearchServer& search_server, int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
     search_server.AddDocument(document_id, document, status, ratings);
 }
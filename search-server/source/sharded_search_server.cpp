@@ -0,0 +1,133 @@
+#include "../header/sharded_search_server.h"
+
+ShardedSearchServer::ShardedSearchServer(size_t shard_count, const std::string& stop_words) {
+    CreateShards(shard_count, stop_words);
+}
+
+ShardedSearchServer::ShardedSearchServer(size_t shard_count, std::string_view stop_words) {
+    CreateShards(shard_count, stop_words);
+}
+
+void ShardedSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector <int>& ratings) {
+    Shard& shard = GetShard(document_id);
+    std::lock_guard <std::shared_mutex> guard(shard.mutex);
+    shard.server.AddDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    Shard& shard = GetShard(document_id);
+    std::lock_guard <std::shared_mutex> guard(shard.mutex);
+    shard.server.RemoveDocument(document_id);
+}
+
+std::vector <Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status, const SearchOptions& options) const {
+    return FindTopDocuments(raw_query, SearchServer::StatusFilter{status}, options);
+}
+
+std::vector <Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query, const SearchOptions& options) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL, options);
+}
+
+// The returned views point into the shard's dictionary and stay valid until that shard is compacted
+std::tuple <std::vector <std::string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
+    const Shard& shard = GetShard(document_id);
+    std::shared_lock <std::shared_mutex> lock(shard.mutex);
+    return shard.server.MatchDocument(raw_query, document_id);
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    const auto locks = LockAllShared();
+    int document_count = 0;
+
+    for (const Shard& shard : shards_) {
+        document_count += shard.server.GetDocumentCount();
+    }
+
+    return document_count;
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+ShardedSearchServer::Shard& ShardedSearchServer::GetShard(int document_id) {
+    return shards_[static_cast <uint64_t> (document_id) % shards_.size()];
+}
+
+const ShardedSearchServer::Shard& ShardedSearchServer::GetShard(int document_id) const {
+    return shards_[static_cast <uint64_t> (document_id) % shards_.size()];
+}
+
+// Always in shard order; writers hold a single shard, so this cannot deadlock with them
+std::vector <std::shared_lock <std::shared_mutex>> ShardedSearchServer::LockAllShared() const {
+    std::vector <std::shared_lock <std::shared_mutex>> locks;
+    locks.reserve(shards_.size());
+
+    for (const Shard& shard : shards_) {
+        locks.emplace_back(shard.mutex);
+    }
+
+    return locks;
+}
+
+// Same log(N) - log(df) a single server would compute, with N and df summed over the shards
+std::vector <double> ShardedSearchServer::ComputeInverseDocumentFreqs(const SearchServer::Query& query) const {
+    size_t document_count = 0;
+
+    for (const Shard& shard : shards_) {
+        document_count += shard.server.GetDocumentCount();
+    }
+
+    const double log_document_count = std::log(document_count);
+    std::vector <double> inverse_document_freqs;
+    inverse_document_freqs.reserve(query.plus_words.size());
+
+    for (const std::string_view word : query.plus_words) {
+        uint64_t document_freq = 0;
+
+        for (const Shard& shard : shards_) {
+            document_freq += shard.server.GetDocumentFreq(word);
+        }
+
+        inverse_document_freqs.push_back(document_freq == 0 ? 0.0 : log_document_count - std::log(document_freq));
+    }
+
+    return inverse_document_freqs;
+}
+
+// k-way merge of the per-shard tops, each already sorted by MoreRelevant
+std::vector <Document> ShardedSearchServer::MergeTopDocuments(const std::vector <std::vector <Document>>& shard_top_documents, size_t max_count) {
+    using Cursor = std::pair <size_t, size_t>;
+
+    auto less_relevant = [&shard_top_documents](const Cursor& lhs, const Cursor& rhs) {
+        return MoreRelevant()(shard_top_documents[rhs.first][rhs.second], shard_top_documents[lhs.first][lhs.second]);
+    };
+
+    std::vector <Cursor> heads;
+
+    for (size_t shard = 0; shard < shard_top_documents.size(); ++shard) {
+        if (!shard_top_documents[shard].empty()) {
+            heads.push_back({shard, 0});
+        }
+    }
+
+    std::make_heap(heads.begin(), heads.end(), less_relevant);
+
+    std::vector <Document> top_documents;
+
+    while (!heads.empty() && top_documents.size() < max_count) {
+        std::pop_heap(heads.begin(), heads.end(), less_relevant);
+        const auto [shard, position] = heads.back();
+
+        top_documents.push_back(shard_top_documents[shard][position]);
+
+        if (position + 1 < shard_top_documents[shard].size()) {
+            heads.back().second = position + 1;
+            std::push_heap(heads.begin(), heads.end(), less_relevant);
+        } else {
+            heads.pop_back();
+        }
+    }
+
+    return top_documents;
+}
@@ -0,0 +1,422 @@
+#include <fstream>
+#include <cstddef>
+#include <cstdio>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <numeric>
+
+#include "../header/snapshot.h"
+#include "../header/mapped_file.h"
+#include "../header/search_server.h"
+
+static_assert(sizeof(PostingList::Block) == 24, "posting block headers are stored as they are");
+
+namespace {
+    uint64_t RotateLeft(uint64_t value, int shift) {
+        return (value << shift) | (value >> (64 - shift));
+    }
+}
+
+void SnapshotChecksum::Update(const char* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+
+    length_ += size;
+
+    if (pending_size_ > 0) {
+        const size_t taken = std::min(size, sizeof(pending_) - pending_size_);
+
+        std::memcpy(pending_ + pending_size_, data, taken);
+        pending_size_ += taken;
+        data += taken;
+        size -= taken;
+
+        if (pending_size_ < sizeof(pending_)) {
+            return;
+        }
+
+        AddWord(pending_);
+        pending_size_ = 0;
+    }
+
+    for (; size >= 8; data += 8, size -= 8) {
+        AddWord(data);
+    }
+
+    std::memcpy(pending_, data, size);
+    pending_size_ = size;
+}
+
+uint64_t SnapshotChecksum::Get() const {
+    uint64_t hash = state_ ^ length_;
+
+    for (size_t index = 0; index < pending_size_; ++index) {
+        hash = (hash ^ static_cast <unsigned char> (pending_[index])) * 0x100000001B3ull;
+    }
+
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+void SnapshotChecksum::AddWord(const char* data) {
+    uint64_t word;
+    std::memcpy(&word, data, sizeof(word));
+
+    state_ = RotateLeft(state_ + word * 0xC2B2AE3D27D4EB4Full, 31) * 0x9E3779B185EBCA87ull;
+}
+
+SnapshotWriter::SnapshotWriter(std::ostream& output)
+    : output_(output) {}
+
+void SnapshotWriter::WriteStrings(const std::vector <std::string_view>& strings) {
+    std::vector <uint64_t> offsets;
+    std::string characters;
+
+    offsets.reserve(strings.size() + 1);
+    offsets.push_back(0);
+
+    for (const std::string_view str : strings) {
+        characters.append(str);
+        offsets.push_back(characters.size());
+    }
+
+    WriteArray(offsets.data(), offsets.size());
+    WriteArray(characters.data(), characters.size());
+}
+
+void SnapshotWriter::BeginArray(size_t count) {
+    const uint64_t stored_count = count;
+
+    WriteBytes(reinterpret_cast <const char*> (&stored_count), sizeof(stored_count));
+    array_bytes_ = 0;
+}
+
+void SnapshotWriter::EndArray() {
+    const char padding[8] = {};
+    WriteBytes(padding, (8 - array_bytes_ % 8) % 8);
+}
+
+uint64_t SnapshotWriter::GetPayloadSize() const {
+    return payload_size_;
+}
+
+uint64_t SnapshotWriter::GetChecksum() const {
+    return checksum_.Get();
+}
+
+void SnapshotWriter::WriteBytes(const char* data, size_t size) {
+    output_.write(data, size);
+    checksum_.Update(data, size);
+    payload_size_ += size;
+}
+
+SnapshotReader::SnapshotReader(const char* data, size_t size)
+    : data_(data), size_(size) {}
+
+std::vector <std::string_view> SnapshotReader::ReadStrings() {
+    const SnapshotStrings table = ReadStringTable();
+    std::vector <std::string_view> strings;
+
+    strings.reserve(table.size());
+
+    for (size_t index = 0; index < table.size(); ++index) {
+        strings.push_back(table[index]);
+    }
+
+    return strings;
+}
+
+SnapshotStrings SnapshotReader::ReadStringTable() {
+    const SnapshotArray <uint64_t> offsets = ReadArray <uint64_t> ();
+    const SnapshotArray <char> characters = ReadArray <char> ();
+
+    if (offsets.size == 0 || offsets[0] != 0 || offsets[offsets.size - 1] != characters.size) {
+        throw std::invalid_argument("corrupted snapshot string table");
+    }
+
+    for (size_t index = 0; index + 1 < offsets.size; ++index) {
+        if (offsets[index] > offsets[index + 1]) {
+            throw std::invalid_argument("corrupted snapshot string table");
+        }
+    }
+
+    return {offsets, characters};
+}
+
+bool SnapshotReader::AtEnd() const {
+    return position_ == size_;
+}
+
+// Written next to the file and renamed over it, so a server still viewing the old file keeps its pages
+void SearchServer::SaveSnapshot(const std::string& path) const {
+    const std::string temporary_path = path + ".tmp"s;
+    std::ofstream output(temporary_path, std::ios::binary | std::ios::trunc);
+
+    if (!output) {
+        throw std::runtime_error("cannot create snapshot "s + temporary_path);
+    }
+
+    SnapshotHeader header = {};
+    output.write(reinterpret_cast <const char*> (&header), sizeof(header));
+
+    SnapshotWriter writer(output);
+
+    writer.WriteStrings(std::vector <std::string_view> (stop_words_.begin(), stop_words_.end()));
+
+    std::vector <std::string_view> words;
+    std::vector <uint32_t> sorted_term_ids(terms_.size());
+
+    words.reserve(terms_.size());
+
+    for (uint32_t term_id = 0; term_id < terms_.size(); ++term_id) {
+        words.push_back(terms_.GetWord(term_id));
+    }
+
+    std::iota(sorted_term_ids.begin(), sorted_term_ids.end(), 0u);
+    std::sort(sorted_term_ids.begin(), sorted_term_ids.end(), [&words](const uint32_t lhs, const uint32_t rhs) {
+        return words[lhs] < words[rhs];
+    });
+
+    writer.WriteStrings(words);
+    writer.WriteArray(sorted_term_ids.data(), sorted_term_ids.size());
+    writer.WriteArray(document_freqs_.data(), document_freqs_.size());
+
+    // postings of tombstoned documents are not written: lists holding any are filtered into a copy
+    std::vector <const PostingList*> live_postings;
+    std::deque <PostingList> filtered_postings;
+
+    for (uint32_t term_id = 0; term_id < postings_.size(); ++term_id) {
+        if (postings_[term_id].size() == document_freqs_[term_id]) {
+            live_postings.push_back(&postings_[term_id]);
+            continue;
+        }
+
+        PostingList& term_postings = filtered_postings.emplace_back(postings_[term_id]);
+
+        term_postings.RemoveIf([this](const PostingList::Posting& posting) {
+            return IsRemoved(posting.document_id);
+        });
+
+        live_postings.push_back(&term_postings);
+    }
+
+    std::vector <uint64_t> byte_offsets(1, 0);
+    std::vector <uint64_t> block_offsets(1, 0);
+
+    for (const PostingList* term_postings : live_postings) {
+        byte_offsets.push_back(byte_offsets.back() + term_postings->GetByteCount());
+        block_offsets.push_back(block_offsets.back() + term_postings->GetBlockCount());
+    }
+
+    writer.WriteArray(byte_offsets.data(), byte_offsets.size());
+    writer.BeginArray(byte_offsets.back());
+
+    for (const PostingList* term_postings : live_postings) {
+        writer.AppendElements(term_postings->GetByteData(), term_postings->GetByteCount());
+    }
+
+    writer.EndArray();
+    writer.WriteArray(block_offsets.data(), block_offsets.size());
+    writer.BeginArray(block_offsets.back());
+
+    std::vector <PostingList::Block> stored_blocks;
+
+    for (const PostingList* term_postings : live_postings) {
+        stored_blocks.clear();
+
+        for (size_t block = 0; block < term_postings->GetBlockCount(); ++block) {
+            const PostingList::Block& header = term_postings->GetBlockData()[block];
+            // value-initialized, so the padding is zero and equal indexes give equal files
+            PostingList::Block& stored_block = stored_blocks.emplace_back();
+
+            stored_block.first_document_id = header.first_document_id;
+            stored_block.last_document_id = header.last_document_id;
+            stored_block.size = header.size;
+            stored_block.offset = header.offset;
+        }
+
+        writer.AppendElements(stored_blocks.data(), stored_blocks.size());
+    }
+
+    writer.EndArray();
+    writer.WriteArray(max_term_freqs_.data(), max_term_freqs_.size());
+
+    std::vector <int32_t> document_ids, ratings, statuses;
+    std::vector <uint32_t> word_counts;
+    std::vector <uint64_t> forward_offsets(1, 0);
+
+    // in id order, not in table order
+    for (const int document_id : documents_) {
+        const uint32_t ordinal = documents_.Find(document_id);
+
+        document_ids.push_back(document_id);
+        ratings.push_back(documents_.GetRating(ordinal));
+        statuses.push_back(static_cast <int32_t> (documents_.GetStatus(ordinal)));
+        word_counts.push_back(documents_.GetWordCount(ordinal));
+        forward_offsets.push_back(forward_offsets.back() + documents_.GetTermIds(ordinal).size());
+    }
+
+    writer.WriteArray(document_ids.data(), document_ids.size());
+    writer.WriteArray(ratings.data(), ratings.size());
+    writer.WriteArray(statuses.data(), statuses.size());
+    writer.WriteArray(word_counts.data(), word_counts.size());
+    writer.WriteArray(forward_offsets.data(), forward_offsets.size());
+    writer.BeginArray(forward_offsets.back());
+
+    for (const int document_id : document_ids) {
+        const DocumentTable::TermIdSpan term_ids = documents_.GetTermIds(documents_.Find(document_id));
+        writer.AppendElements(term_ids.begin(), term_ids.size());
+    }
+
+    writer.EndArray();
+
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.endian_tag = SNAPSHOT_ENDIAN_TAG;
+    header.payload_size = writer.GetPayloadSize();
+    header.checksum = writer.GetChecksum();
+
+    output.seekp(0);
+    output.write(reinterpret_cast <const char*> (&header), sizeof(header));
+    output.close();
+
+    if (!output) {
+        std::remove(temporary_path.c_str());
+        throw std::runtime_error("cannot write snapshot "s + temporary_path);
+    }
+
+    // where rename does not replace an existing file, the old one has to go first
+    if (std::rename(temporary_path.c_str(), path.c_str()) != 0 && (std::remove(path.c_str()), std::rename(temporary_path.c_str(), path.c_str()) != 0)) {
+        std::remove(temporary_path.c_str());
+        throw std::runtime_error("cannot write snapshot "s + path);
+    }
+}
+
+/*
+ * Queries are served from the mapping, which the server keeps until it is destroyed: posting lists,
+ * words and forward lists view the file and are copied to the heap only when a change touches them.
+ * Loading reads the file once for the checksum and otherwise touches only what fills the in-memory
+ * structures: the document columns, status bits and id pages (O(documents)), the frequency arrays
+ * and the word order check (O(terms)) and the posting block headers. The encoded postings and the
+ * forward term ids are not decoded; the checksum catches a damaged file, not a forged one.
+ */
+SearchServer SearchServer::LoadSnapshot(const std::string& path) {
+    auto file = std::make_unique <const MappedFile> (path);
+    SnapshotHeader header;
+
+    if (file->size() < sizeof(header)) {
+        throw std::invalid_argument("truncated snapshot"s);
+    }
+
+    std::memcpy(&header, file->data(), sizeof(header));
+
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.endian_tag != SNAPSHOT_ENDIAN_TAG) {
+        throw std::invalid_argument("not a search server snapshot"s);
+    }
+
+    if (header.version != SNAPSHOT_VERSION) {
+        throw std::invalid_argument("unsupported snapshot version "s + std::to_string(header.version));
+    }
+
+    if (header.payload_size != file->size() - sizeof(header)) {
+        throw std::invalid_argument("truncated snapshot"s);
+    }
+
+    const char* payload = file->data() + sizeof(header);
+    SnapshotChecksum checksum;
+    checksum.Update(payload, header.payload_size);
+
+    if (checksum.Get() != header.checksum) {
+        throw std::invalid_argument("snapshot checksum mismatch"s);
+    }
+
+    SnapshotReader reader(payload, header.payload_size);
+    SearchServer search_server;
+
+    for (const std::string_view word : reader.ReadStrings()) {
+        search_server.stop_words_.emplace_hint(search_server.stop_words_.end(), word);
+    }
+
+    const SnapshotStrings words = reader.ReadStringTable();
+    const size_t term_count = words.size();
+    const SnapshotArray <uint32_t> sorted_term_ids = reader.ReadArray <uint32_t> ();
+    const SnapshotArray <uint32_t> document_freqs = reader.ReadArray <uint32_t> ();
+
+    if (sorted_term_ids.size != term_count || document_freqs.size != term_count) {
+        throw std::invalid_argument("corrupted snapshot terms"s);
+    }
+
+    for (size_t index = 0; index < term_count; ++index) {
+        if (sorted_term_ids[index] >= term_count || (index > 0 && !(words[sorted_term_ids[index - 1]] < words[sorted_term_ids[index]]))) {
+            throw std::invalid_argument("corrupted snapshot terms"s);
+        }
+    }
+
+    const SnapshotArray <uint64_t> byte_offsets = reader.ReadArray <uint64_t> ();
+    const SnapshotArray <uint8_t> posting_bytes = reader.ReadArray <uint8_t> ();
+    const SnapshotArray <uint64_t> block_offsets = reader.ReadArray <uint64_t> ();
+    const SnapshotArray <PostingList::Block> posting_blocks = reader.ReadArray <PostingList::Block> ();
+    const SnapshotArray <double> max_term_freqs = reader.ReadArray <double> ();
+
+    if (byte_offsets.size != term_count + 1 || byte_offsets[term_count] != posting_bytes.size
+            || block_offsets.size != term_count + 1 || block_offsets[term_count] != posting_blocks.size || max_term_freqs.size != term_count) {
+        throw std::invalid_argument("corrupted snapshot postings"s);
+    }
+
+    search_server.postings_.resize(term_count);
+    search_server.document_freqs_.assign(document_freqs.begin(), document_freqs.end());
+    search_server.log_document_freqs_.resize(term_count);
+    search_server.max_term_freqs_.assign(max_term_freqs.begin(), max_term_freqs.end());
+
+    for (size_t term_id = 0; term_id < term_count; ++term_id) {
+        if (byte_offsets[term_id] > byte_offsets[term_id + 1] || block_offsets[term_id] > block_offsets[term_id + 1]
+                || !(max_term_freqs[term_id] >= 0.0 && max_term_freqs[term_id] <= 1.0)
+                || !search_server.postings_[term_id].View(posting_bytes.data + byte_offsets[term_id], byte_offsets[term_id + 1] - byte_offsets[term_id],
+                        posting_blocks.data + block_offsets[term_id], block_offsets[term_id + 1] - block_offsets[term_id], document_freqs[term_id])) {
+            throw std::invalid_argument("corrupted snapshot postings"s);
+        }
+
+        search_server.log_document_freqs_[term_id] = std::log(document_freqs[term_id]);
+    }
+
+    const SnapshotArray <int32_t> document_ids = reader.ReadArray <int32_t> ();
+    const SnapshotArray <int32_t> ratings = reader.ReadArray <int32_t> ();
+    const SnapshotArray <int32_t> statuses = reader.ReadArray <int32_t> ();
+    const SnapshotArray <uint32_t> word_counts = reader.ReadArray <uint32_t> ();
+    const SnapshotArray <uint64_t> forward_offsets = reader.ReadArray <uint64_t> ();
+    const SnapshotArray <uint32_t> forward_index = reader.ReadArray <uint32_t> ();
+
+    if (ratings.size != document_ids.size || statuses.size != document_ids.size || word_counts.size != document_ids.size
+            || forward_offsets.size != document_ids.size + 1 || forward_offsets[0] != 0 || forward_offsets[document_ids.size] != forward_index.size || !reader.AtEnd()) {
+        throw std::invalid_argument("corrupted snapshot documents"s);
+    }
+
+    for (size_t index = 0; index < document_ids.size; ++index) {
+        if ((index > 0 && document_ids[index - 1] >= document_ids[index]) || document_ids[index] < 0
+                || statuses[index] < static_cast <int32_t> (DocumentStatus::ACTUAL) || statuses[index] > static_cast <int32_t> (DocumentStatus::REMOVED)) {
+            throw std::invalid_argument("corrupted snapshot documents"s);
+        }
+
+        if (forward_offsets[index] > forward_offsets[index + 1] || word_counts[index] < forward_offsets[index + 1] - forward_offsets[index]) {
+            throw std::invalid_argument("corrupted snapshot forward index"s);
+        }
+    }
+
+    for (size_t term_id = 0; term_id < term_count; ++term_id) {
+        if (document_freqs[term_id] > document_ids.size) {
+            throw std::invalid_argument("corrupted snapshot postings"s);
+        }
+    }
+
+    search_server.terms_.View(words.offsets.data, words.characters.data, sorted_term_ids.data, term_count);
+    search_server.documents_.ViewRows(document_ids.size, document_ids.data, ratings.data, statuses.data, word_counts.data, forward_offsets.data, forward_index.data);
+    search_server.log_document_count_ = std::log(search_server.documents_.GetLiveCount());
+    search_server.snapshot_file_ = std::move(file);
+
+    return search_server;
+}
@@ -1,20 +1,225 @@
 #include "../header/string_processing.h"
 
-std::vector <std::string> SplitIntoWords(const std::string& text) {
-    std::vector <std::string> words;
-    std::string word;
-
-    for (size_t index = 0; index < text.length(); ++index) {
-        if (text[index] == ' ') {
-            if (!word.empty()) {
-                words.push_back(word);
-                word.clear();
+#include <cstdint>
+
+// The SSE2 and AVX2 versions are compiled for their targets alone, so an i386 build without -msse2
+// has them too, and each is only run when the CPU has it. SSE2 is part of x86-64.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SEARCH_SERVER_X86_TOKENIZER
+#include <immintrin.h>
+#endif
+
+namespace {
+    // Where a scan is: the next byte to look at and the first byte of the word being read
+    struct TokenizerState {
+        size_t position = 0;
+        size_t word_begin = 0;
+    };
+
+    void AddWord(std::string_view text, size_t word_begin, size_t word_end, std::pmr::vector <std::string_view>& words) {
+        if (word_end > word_begin) {
+            words.push_back(text.substr(word_begin, word_end - word_begin));
+        }
+    }
+
+    // Finishes a scan one byte at a time, the whole scan for the scalar version
+    void TokenizeTail(std::string_view text, TokenizerState& state, TokenizedText& result) {
+        for (; state.position < text.size(); ++state.position) {
+            const unsigned char c = text[state.position];
+
+            if (c == ' ') {
+                AddWord(text, state.word_begin, state.position, result.words);
+                state.word_begin = state.position + 1;
+            } else if (c < ' ') {
+                result.has_control_characters = true;
+            }
+        }
+
+        AddWord(text, state.word_begin, text.size(), result.words);
+    }
+
+    bool HasControlCharactersTail(std::string_view text, size_t position) {
+        for (; position < text.size(); ++position) {
+            if (static_cast <unsigned char> (text[position]) < ' ') {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+#ifdef SEARCH_SERVER_X86_TOKENIZER
+    // Bit i of space_mask is set when byte chunk_begin + i is a space
+    inline void AddWords(std::string_view text, size_t chunk_begin, uint32_t space_mask, size_t& word_begin, std::pmr::vector <std::string_view>& words) {
+        for (; space_mask != 0; space_mask &= space_mask - 1) {
+            const size_t space = chunk_begin + __builtin_ctz(space_mask);
+
+            AddWord(text, word_begin, space, words);
+            word_begin = space + 1;
+        }
+    }
+
+    // A byte is below ' ' exactly when subtracting ' ' - 1 with unsigned saturation leaves 0
+    __attribute__((target("sse2")))
+    inline __m128i FindControlCharacters(__m128i chunk) {
+        return _mm_cmpeq_epi8(_mm_subs_epu8(chunk, _mm_set1_epi8(' ' - 1)), _mm_setzero_si128());
+    }
+
+    __attribute__((target("sse2")))
+    inline bool TokenizeSse2Chunk(std::string_view text, TokenizerState& state, TokenizedText& result) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast <const __m128i*> (text.data() + state.position));
+        const uint32_t space_mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')));
+
+        AddWords(text, state.position, space_mask, state.word_begin, result.words);
+        state.position += 16;
+
+        return _mm_movemask_epi8(FindControlCharacters(chunk)) != 0;
+    }
+
+    __attribute__((target("sse2")))
+    TokenizedText TokenizeSse2(std::string_view text, std::pmr::memory_resource* resource) {
+        TokenizedText result{std::pmr::vector <std::string_view> (resource)};
+        TokenizerState state;
+        bool has_control_characters = false;
+
+        while (state.position + 16 <= text.size()) {
+            has_control_characters |= TokenizeSse2Chunk(text, state, result);
+        }
+
+        TokenizeTail(text, state, result);
+        result.has_control_characters |= has_control_characters;
+
+        return result;
+    }
+
+    __attribute__((target("sse2")))
+    bool HasControlCharactersSse2(std::string_view text) {
+        size_t position = 0;
+
+        for (; position + 16 <= text.size(); position += 16) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast <const __m128i*> (text.data() + position));
+
+            if (_mm_movemask_epi8(FindControlCharacters(chunk)) != 0) {
+                return true;
             }
-            continue;
-        } else word += text[index];
+        }
+
+        return HasControlCharactersTail(text, position);
     }
 
-    if (!word.empty()) words.push_back(word);
+    __attribute__((target("avx2")))
+    TokenizedText TokenizeAvx2(std::string_view text, std::pmr::memory_resource* resource) {
+        TokenizedText result{std::pmr::vector <std::string_view> (resource)};
+        TokenizerState state;
+        __m256i controls = _mm256_setzero_si256();
+
+        for (; state.position + 32 <= text.size(); state.position += 32) {
+            const __m256i chunk = _mm256_loadu_si256(reinterpret_cast <const __m256i*> (text.data() + state.position));
+            const uint32_t space_mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')));
+
+            controls = _mm256_or_si256(controls, _mm256_cmpeq_epi8(_mm256_subs_epu8(chunk, _mm256_set1_epi8(' ' - 1)), _mm256_setzero_si256()));
+            AddWords(text, state.position, space_mask, state.word_begin, result.words);
+        }
+
+        bool has_control_characters = _mm256_movemask_epi8(controls) != 0;
+
+        // short texts such as queries mostly end up here
+        if (state.position + 16 <= text.size()) {
+            has_control_characters |= TokenizeSse2Chunk(text, state, result);
+        }
+
+        TokenizeTail(text, state, result);
+        result.has_control_characters |= has_control_characters;
+
+        return result;
+    }
+
+    __attribute__((target("avx2")))
+    bool HasControlCharactersAvx2(std::string_view text) {
+        size_t position = 0;
+
+        for (; position + 32 <= text.size(); position += 32) {
+            const __m256i chunk = _mm256_loadu_si256(reinterpret_cast <const __m256i*> (text.data() + position));
+
+            if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_subs_epu8(chunk, _mm256_set1_epi8(' ' - 1)), _mm256_setzero_si256())) != 0) {
+                return true;
+            }
+        }
+
+        return HasControlCharactersSse2(text.substr(position));
+    }
+#endif
+
+    TokenizerIsa DetectTokenizerIsa() {
+#ifdef SEARCH_SERVER_X86_TOKENIZER
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx2")) {
+            return TokenizerIsa::AVX2;
+        }
+
+        if (__builtin_cpu_supports("sse2")) {
+            return TokenizerIsa::SSE2;
+        }
+#endif
+
+        return TokenizerIsa::SCALAR;
+    }
+}
+
+TokenizedText TokenizeText(std::string_view text, std::pmr::memory_resource* resource) {
+    return TokenizeText(GetTokenizerIsa(), text, resource);
+}
+
+bool HasControlCharacters(std::string_view text) {
+    return HasControlCharacters(GetTokenizerIsa(), text);
+}
+
+std::vector <std::string_view> SplitIntoWords(std::string_view text) {
+    const TokenizedText tokens = TokenizeText(text);
+    return std::vector <std::string_view> (tokens.words.begin(), tokens.words.end());
+}
+
+TokenizerIsa GetTokenizerIsa() {
+    static const TokenizerIsa isa = DetectTokenizerIsa();
+    return isa;
+}
+
+// Every version the enum lists after SCALAR needs the ones before it
+bool IsTokenizerIsaSupported(TokenizerIsa isa) {
+    return isa <= GetTokenizerIsa();
+}
+
+TokenizedText TokenizeText(TokenizerIsa isa, std::string_view text, std::pmr::memory_resource* resource) {
+#ifdef SEARCH_SERVER_X86_TOKENIZER
+    switch (isa) {
+        case TokenizerIsa::AVX2:
+            return TokenizeAvx2(text, resource);
+        case TokenizerIsa::SSE2:
+            return TokenizeSse2(text, resource);
+        case TokenizerIsa::SCALAR:
+            break;
+    }
+#endif
+
+    TokenizedText result{std::pmr::vector <std::string_view> (resource)};
+    TokenizerState state;
+    TokenizeTail(text, state, result);
+
+    return result;
+}
+
+bool HasControlCharacters(TokenizerIsa isa, std::string_view text) {
+#ifdef SEARCH_SERVER_X86_TOKENIZER
+    switch (isa) {
+        case TokenizerIsa::AVX2:
+            return HasControlCharactersAvx2(text);
+        case TokenizerIsa::SSE2:
+            return HasControlCharactersSse2(text);
+        case TokenizerIsa::SCALAR:
+            break;
+    }
+#endif
 
-    return words;
+    return HasControlCharactersTail(text, 0);
 }
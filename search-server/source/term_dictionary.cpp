@@ -0,0 +1,59 @@
+#include "../header/term_dictionary.h"
+
+#include <algorithm>
+
+uint32_t TermDictionary::Find(std::string_view word) const {
+    if (viewed_word_count_ > 0) {
+        const uint32_t* const sorted_term_ids_end = viewed_sorted_term_ids_ + viewed_word_count_;
+        const uint32_t* const term_id_iter = std::lower_bound(viewed_sorted_term_ids_, sorted_term_ids_end, word, [this](const uint32_t term_id, std::string_view query_word) {
+            return GetWord(term_id) < query_word;
+        });
+
+        if (term_id_iter != sorted_term_ids_end && GetWord(*term_id_iter) == word) {
+            return *term_id_iter;
+        }
+    }
+
+    const auto iter = word_to_id_.find(word);
+    return iter == word_to_id_.end() ? NO_TERM : iter->second;
+}
+
+uint32_t TermDictionary::Intern(std::string_view word) {
+    const uint32_t term_id = Find(word);
+
+    if (term_id != NO_TERM) {
+        return term_id;
+    }
+
+    char* const data = static_cast <char*> (storage_->allocate(word.size(), 1));
+    const std::string_view stored_word = words_.emplace_back(data, word.copy(data, word.size()));
+
+    stored_bytes_ += word.size();
+    word_to_id_.emplace(stored_word, static_cast <uint32_t> (size() - 1));
+
+    return static_cast <uint32_t> (size() - 1);
+}
+
+std::string_view TermDictionary::GetWord(uint32_t term_id) const {
+    if (term_id < viewed_word_count_) {
+        return std::string_view(viewed_characters_ + viewed_offsets_[term_id], viewed_offsets_[term_id + 1] - viewed_offsets_[term_id]);
+    }
+
+    return words_.at(term_id - viewed_word_count_);
+}
+
+void TermDictionary::View(const uint64_t* offsets, const char* characters, const uint32_t* sorted_term_ids, size_t word_count) {
+    viewed_offsets_ = offsets;
+    viewed_characters_ = characters;
+    viewed_sorted_term_ids_ = sorted_term_ids;
+    viewed_word_count_ = word_count;
+}
+
+size_t TermDictionary::size() const {
+    return viewed_word_count_ + words_.size();
+}
+
+size_t TermDictionary::GetByteSize() const {
+    return stored_bytes_ + words_.capacity() * sizeof(std::string_view) + word_to_id_.bucket_count() * sizeof(void*)
+        + word_to_id_.size() * (sizeof(std::pair <const std::string_view, uint32_t>) + sizeof(void*));
+}
@@ -1,5 +1,1842 @@
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#include <thread>
+
 #include "../header/test_example_functions.h"
 
+void AssertImpl(bool value, const std::string& expr_str, const std::string& file, const std::string& func, unsigned line, const std::string& hint) {
+    if (!value) {
+        std::cerr << file << "("s << line << "): "s << func << ": "s << "ASSERT("s << expr_str << ") failed."s;
+
+        if (!hint.empty()) {
+            std::cerr << " Hint: "s << hint;
+        }
+
+        std::cerr << std::endl;
+        std::abort();
+    }
+}
+
+// Recomputes every returned relevance with the textbook tf * log(N / df) and checks the server's
+// incrementally maintained IDF table against it, also after the corpus has been changed
+void TestRelevanceMatchesIdfFormula() {
+    std::mt19937 generator(17);
+    std::vector <std::string> vocabulary;
+
+    for (int index = 0; index < 60; ++index) {
+        vocabulary.push_back("w"s + std::to_string(index));
+    }
+
+    SearchServer search_server("w0 w1"s);
+
+    auto check_queries = [&]() {
+        std::map <std::string_view, int> document_freqs;
+
+        for (const int document_id : search_server) {
+            for (const auto& [word, _] : search_server.GetWordFrequencies(document_id)) {
+                ++document_freqs[word];
+            }
+        }
+
+        for (int query_index = 0; query_index < 50; ++query_index) {
+            std::vector <std::string> query_words;
+            std::string query;
+
+            for (int word_index = 0; word_index < 4; ++word_index) {
+                query_words.push_back(vocabulary[generator() % vocabulary.size()]);
+                query += query_words.back() + " "s;
+            }
+
+            std::sort(query_words.begin(), query_words.end());
+            query_words.erase(std::unique(query_words.begin(), query_words.end()), query_words.end());
+
+            for (const Document& document : search_server.FindTopDocuments(query, SearchOptions{1000})) {
+                const std::map <std::string_view, double>& word_freqs = search_server.GetWordFrequencies(document.id);
+                double expected_relevance = 0.0;
+
+                for (const std::string& word : query_words) {
+                    const auto word_iter = word_freqs.find(word);
+
+                    if (word_iter != word_freqs.end()) {
+                        expected_relevance += word_iter->second * std::log(search_server.GetDocumentCount() * 1.0 / document_freqs.at(word));
+                    }
+                }
+
+                ASSERT_HINT(std::abs(document.relevance - expected_relevance) < 1e-12, "relevance of document "s + std::to_string(document.id) + " for query "s + query);
+            }
+        }
+    };
+
+    for (int document_id = 0; document_id < 500; ++document_id) {
+        std::string text;
+
+        for (size_t word_index = 1 + generator() % 12; word_index > 0; --word_index) {
+            text += vocabulary[generator() % vocabulary.size()] + " "s;
+        }
+
+        search_server.AddDocument(document_id, text, DocumentStatus::ACTUAL, {1});
+    }
+
+    check_queries();
+
+    for (int document_id = 0; document_id < 500; document_id += 3) {
+        search_server.RemoveDocument(document_id);
+    }
+
+    check_queries();
+
+    search_server.AddDocument(1000, "w2 w3 w3"s, DocumentStatus::ACTUAL, {1});
+
+    check_queries();
+}
+
+// Per-request K over every evaluation path: no documents for 0, the leading K of the full ranking
+// otherwise, all matches when K exceeds them. Ties in relevance are broken by rating, then by id.
+void TestResultCountAndTieBreak() {
+    ASSERT(MoreRelevant()(Document(2, 0.5 + ACCURACY / 2, 7), Document(1, 0.5, 3)));
+    ASSERT(MoreRelevant()(Document(1, 0.5 + ACCURACY * 2, 3), Document(2, 0.5, 7)));
+    ASSERT(MoreRelevant()(Document(1, 0.5, 7), Document(2, 0.5 + ACCURACY / 2, 7)));
+    ASSERT(!MoreRelevant()(Document(2, 0.5, 7), Document(1, 0.5 + ACCURACY / 2, 7)));
+
+    SearchServer search_server("and"s);
+    // ids 1-6 tie in relevance; 7 is ahead of them whatever its rating, 8 does not match
+    const std::vector <std::pair <int, int>> ratings = {{1, 9}, {2, 5}, {3, -1}, {4, 5}, {5, 9}, {6, 5}};
+
+    for (const auto& [document_id, rating] : ratings) {
+        search_server.AddDocument(document_id, "cat and dog"s + std::to_string(document_id), DocumentStatus::ACTUAL, {rating});
+    }
+
+    search_server.AddDocument(7, "cat cat"s, DocumentStatus::ACTUAL, {-5});
+    search_server.AddDocument(8, "bird"s, DocumentStatus::ACTUAL, {100});
+
+    const std::vector <int> expected_ids = {7, 1, 5, 2, 4, 6, 3};
+
+    auto get_ids = [](const std::vector <Document>& documents) {
+        std::vector <int> ids;
+
+        for (const Document& document : documents) {
+            ids.push_back(document.id);
+        }
+
+        return ids;
+    };
+
+    for (const size_t max_count : {size_t{0}, size_t{1}, size_t{3}, size_t{6}, expected_ids.size(), size_t{100}}) {
+        const std::vector <int> expected(expected_ids.begin(), expected_ids.begin() + std::min(max_count, expected_ids.size()));
+        const std::string hint = "K = "s + std::to_string(max_count);
+
+        ASSERT_HINT(get_ids(search_server.FindTopDocuments("cat"s, SearchOptions{max_count})) == expected, hint);
+        ASSERT_HINT(get_ids(search_server.FindTopDocuments("cat"s, SearchOptions{max_count, false})) == expected, hint);
+        ASSERT_HINT(get_ids(search_server.FindTopDocuments(std::execution::par, "cat"s, SearchOptions{max_count})) == expected, hint);
+        ASSERT_HINT(get_ids(search_server.FindTopDocuments("cat -dog3"s, SearchOptions{max_count})).size() == std::min(max_count, expected_ids.size() - 1), hint);
+    }
+
+    const std::vector <Document> default_documents = search_server.FindTopDocuments("cat"s);
+    ASSERT(get_ids(default_documents) == std::vector <int> (expected_ids.begin(), expected_ids.begin() + MAX_RESULT_DOCUMENT_COUNT));
+    ASSERT(default_documents[1].relevance == default_documents[2].relevance && default_documents[1].rating == 9 && default_documents[3].rating == 5);
+}
+
+// Unknown words must come back as NO_TERM without being added, whether the dictionary owns its
+// words or views a word table, including prefixes and extensions of known words
+void TestTermDictionary() {
+    TermDictionary terms;
+
+    ASSERT(terms.Find("cat"s) == TermDictionary::NO_TERM && terms.Find(""s) == TermDictionary::NO_TERM);
+    ASSERT(terms.Intern("cat"s) == 0 && terms.Intern("dog"s) == 1 && terms.Intern("cat"s) == 0);
+
+    for (const std::string& word : {"ca"s, "cats"s, "Cat"s, "bird"s, ""s}) {
+        ASSERT_HINT(terms.Find(word) == TermDictionary::NO_TERM, word);
+    }
+
+    ASSERT(terms.size() == 2 && terms.GetWord(1) == "dog"s);
+
+    // "dog", "ant", "cat" as ids 0, 1, 2
+    const std::vector <uint64_t> offsets = {0, 3, 6, 9};
+    const std::string characters = "dogantcat"s;
+    const std::vector <uint32_t> sorted_term_ids = {1, 2, 0};
+    TermDictionary viewed;
+
+    viewed.View(offsets.data(), characters.data(), sorted_term_ids.data(), 3);
+    ASSERT(viewed.Find("ant"s) == 1 && viewed.Find("cat"s) == 2 && viewed.Find("dog"s) == 0);
+
+    for (const std::string& word : {"an"s, "ants"s, "bee"s, "aardvark"s, "zebra"s, ""s}) {
+        ASSERT_HINT(viewed.Find(word) == TermDictionary::NO_TERM, word);
+    }
+
+    ASSERT(viewed.size() == 3 && viewed.Intern("bee"s) == 3 && viewed.Intern("cat"s) == 2);
+    ASSERT(viewed.Find("bee"s) == 3 && viewed.GetWord(3) == "bee"s && viewed.Find("bees"s) == TermDictionary::NO_TERM);
+
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "cat and dog"s, DocumentStatus::ACTUAL, {1});
+
+    ASSERT(search_server.FindTopDocuments("mouse"s).empty() && search_server.FindTopDocuments("and"s).empty());
+    ASSERT(search_server.FindTopDocuments("dog -mouse"s).size() == 1 && search_server.FindTopDocuments("mouse -cat"s).empty());
+    ASSERT(std::get <0> (search_server.MatchDocument("mouse dog"s, 1)) == std::vector <std::string_view> {"dog"s});
+}
+
+// Random inserts, erases and merges checked against a plain map after every step, including the
+// block headers a scan uses to skip, and a view over the encoded form
+void TestPostingList() {
+    std::mt19937 generator(41);
+    PostingList postings;
+    std::map <int, uint32_t> expected;
+
+    auto check_postings = [&]() {
+        ASSERT(postings.size() == expected.size());
+        ASSERT(std::equal(postings.begin(), postings.end(), expected.begin(), expected.end(), [](const PostingList::Posting& posting, const auto& entry) {
+            return posting.document_id == entry.first && posting.count == entry.second;
+        }));
+
+        for (int probe = 0; probe < 20; ++probe) {
+            const int document_id = generator() % 5000;
+            const auto expected_iter = expected.lower_bound(document_id);
+            const PostingList::const_iterator iter = postings.LowerBound(document_id);
+
+            ASSERT(expected_iter == expected.end() ? iter == postings.end() : iter->document_id == expected_iter->first);
+            ASSERT(postings.GetCount(document_id) == (expected.count(document_id) > 0 ? expected.at(document_id) : 0u));
+        }
+    };
+
+    for (int step = 0; step < 3000; ++step) {
+        const int document_id = generator() % 5000;
+        const uint32_t count = 1 + generator() % 300;
+
+        if (step % 7 == 3) {
+            ASSERT(postings.Erase(document_id) == (expected.erase(document_id) > 0));
+        } else if (expected.count(document_id) == 0) {
+            postings.Insert(document_id, count);
+            expected[document_id] = count;
+        }
+
+        if (step % 50 == 0) {
+            check_postings();
+        }
+    }
+
+    std::vector <PostingList::Posting> batch;
+
+    for (int document_id = 0; document_id < 8000; document_id += 1 + generator() % 5) {
+        if (expected.count(document_id) == 0) {
+            batch.push_back({document_id, 2});
+            expected[document_id] = 2;
+        }
+    }
+
+    postings.Merge(batch);
+    check_postings();
+
+    ASSERT(postings.RemoveIf([](const PostingList::Posting& posting) { return posting.document_id % 3 == 0; }) > 0);
+
+    for (auto iter = expected.begin(); iter != expected.end(); ) {
+        iter = iter->first % 3 == 0 ? expected.erase(iter) : std::next(iter);
+    }
+
+    check_postings();
+
+    PostingList viewed;
+    ASSERT(!viewed.View(postings.GetByteData(), postings.GetByteCount(), postings.GetBlockData(), postings.GetBlockCount(), postings.size() + 1));
+    ASSERT(!viewed.View(postings.GetByteData(), postings.GetBlockData()[postings.GetBlockCount() - 1].offset, postings.GetBlockData(), postings.GetBlockCount(), postings.size()));
+    ASSERT(viewed.View(postings.GetByteData(), postings.GetByteCount(), postings.GetBlockData(), postings.GetBlockCount(), postings.size()));
+    ASSERT(viewed.IsView() && viewed.GetByteSize() == 0 && viewed.GetByteData() == postings.GetByteData());
+    ASSERT(viewed.Decode().size() == expected.size() && viewed.GetCount(expected.rbegin()->first) == expected.rbegin()->second);
+
+    // the first change copies the viewed list out and leaves the original alone
+    const std::vector <PostingList::Posting> original = postings.Decode();
+    const int first_id = expected.begin()->first;
+
+    ASSERT(viewed.Erase(first_id) && !viewed.IsView() && viewed.GetByteSize() > 0);
+    viewed.Insert(first_id + 1 - first_id % 3 + 3 * 1000000, 7);
+    ASSERT(viewed.size() == expected.size() && viewed.GetCount(first_id) == 0);
+    ASSERT(postings.Decode().size() == original.size() && postings.GetCount(first_id) == expected.begin()->second);
+}
+
+// Skips and lower bounds at the edges of full blocks: a target on a block's first id, just past a
+// block's last id, between blocks, before the first posting and past the last one
+void TestPostingListBlockBoundaries() {
+    constexpr int BLOCK_SIZE = static_cast <int> (PostingList::BLOCK_SIZE);
+    PostingList postings;
+
+    // even ids, three full blocks and five postings in a fourth
+    for (int index = 0; index < 3 * BLOCK_SIZE + 5; ++index) {
+        postings.Append(2 * index, 1 + index % 7);
+    }
+
+    ASSERT(postings.GetBlockCount() == 4);
+    const int last_id = 2 * (3 * BLOCK_SIZE + 4);
+
+    for (int block = 0; block < 4; ++block) {
+        const PostingList::Block& header = postings.GetBlockData()[block];
+        const std::string hint = "block "s + std::to_string(block);
+
+        ASSERT_HINT(header.first_document_id == 2 * BLOCK_SIZE * block, hint);
+        ASSERT_HINT(postings.LowerBound(header.first_document_id)->document_id == header.first_document_id, hint);
+        ASSERT_HINT(postings.LowerBound(header.first_document_id - 1)->document_id == header.first_document_id, hint);
+        ASSERT_HINT(postings.LowerBound(header.last_document_id)->document_id == header.last_document_id, hint);
+        ASSERT_HINT(postings.GetCount(header.first_document_id) == static_cast <uint32_t> (1 + header.first_document_id / 2 % 7), hint);
+
+        PostingList::const_iterator iter = postings.begin();
+        ASSERT_HINT(iter.SkipTo(header.first_document_id)->document_id == header.first_document_id, hint);
+        ASSERT_HINT(iter.SkipTo(header.first_document_id)->document_id == header.first_document_id && iter.SkipTo(0)->document_id == header.first_document_id, hint);
+        ASSERT_HINT(std::distance(postings.begin(), iter) == BLOCK_SIZE * block, hint);
+
+        if (block < 3) {
+            ASSERT_HINT(postings.LowerBound(header.last_document_id + 1)->document_id == header.last_document_id + 2, hint);
+            ASSERT_HINT(iter.SkipTo(header.last_document_id + 1)->document_id == header.last_document_id + 2, hint);
+        }
+    }
+
+    ASSERT(postings.LowerBound(-1) == postings.begin() && postings.LowerBound(0) == postings.begin());
+    ASSERT(postings.LowerBound(last_id)->document_id == last_id && postings.LowerBound(last_id + 1) == postings.end());
+    ASSERT(postings.LowerBound(INT64_MAX) == postings.end() && postings.GetCount(last_id + 2) == 0);
+
+    PostingList::const_iterator iter = postings.begin();
+    ASSERT(iter.SkipTo(last_id)->document_id == last_id);
+    ASSERT(iter.SkipTo(last_id + 1) == postings.end() && iter.SkipTo(last_id + 1000) == postings.end());
+    ASSERT(postings.begin().SkipTo(INT64_MAX) == postings.end());
+
+    // a list of exactly one full block has nothing past its header
+    PostingList full_block;
+
+    for (int index = 0; index < BLOCK_SIZE; ++index) {
+        full_block.Append(10 + index, 1);
+    }
+
+    ASSERT(full_block.GetBlockCount() == 1 && full_block.LowerBound(10 + BLOCK_SIZE - 1)->document_id == 10 + BLOCK_SIZE - 1);
+    ASSERT(full_block.LowerBound(10 + BLOCK_SIZE) == full_block.end() && full_block.begin().SkipTo(10 + BLOCK_SIZE) == full_block.end());
+
+    // an insert into a full block splits it; every new header must steer lookups the same way
+    postings.Insert(2 * BLOCK_SIZE + 1, 9);
+    ASSERT(postings.GetBlockCount() == 5 && postings.size() == 3 * BLOCK_SIZE + 6);
+
+    for (size_t block = 0; block < postings.GetBlockCount(); ++block) {
+        const PostingList::Block& header = postings.GetBlockData()[block];
+
+        ASSERT(postings.LowerBound(header.first_document_id)->document_id == header.first_document_id);
+        ASSERT(postings.begin().SkipTo(header.first_document_id)->document_id == header.first_document_id);
+        ASSERT(block + 1 == postings.GetBlockCount() || postings.LowerBound(header.last_document_id + 1)->document_id == postings.GetBlockData()[block + 1].first_document_id);
+    }
+
+    ASSERT(postings.LowerBound(2 * BLOCK_SIZE + 1)->count == 9 && postings.LowerBound(2 * BLOCK_SIZE + 2)->document_id == 2 * BLOCK_SIZE + 2);
+}
+
+// Status bits and id pages through remove, release, re-add and compaction: a dead row keeps its
+// ordinal but loses every status bit, a re-added id gets a fresh row, and ids on other pages,
+// the live-id walk and its bounds follow along
+void TestDocumentTable() {
+    DocumentTable documents;
+    const std::vector <int> ids = {5, 4095, 4096, 70000, 6};
+
+    for (size_t index = 0; index < ids.size(); ++index) {
+        ASSERT(documents.Add(ids[index], static_cast <int> (index), static_cast <DocumentStatus> (index % 3), 2, {static_cast <uint32_t> (index)}) == index);
+    }
+
+    auto assert_ids = [&documents](const std::vector <int>& expected_ids) {
+        ASSERT(std::vector <int> (documents.begin(), documents.end()) == expected_ids);
+        ASSERT(documents.GetLiveCount() == expected_ids.size());
+        ASSERT(expected_ids.empty() || (documents.GetMinLiveId() == expected_ids.front() && documents.GetMaxLiveId() == expected_ids.back()));
+    };
+
+    assert_ids({5, 6, 4095, 4096, 70000});
+    ASSERT(documents.Find(7) == DocumentTable::NO_ORDINAL && documents.Find(4097) == DocumentTable::NO_ORDINAL && documents.Find(-1) == DocumentTable::NO_ORDINAL);
+    ASSERT(documents.Find(1 << 30) == DocumentTable::NO_ORDINAL && documents.Find(70000) == 3);
+    ASSERT(documents.HasStatus(2, DocumentStatus::BANNED) && !documents.HasStatus(2, DocumentStatus::ACTUAL));
+
+    // removed: the row and its id stay, the status bit goes
+    documents.MarkRemoved(2);
+    documents.MarkRemoved(3);
+    ASSERT(documents.Find(4096) == 2 && documents.FindLive(4096) == DocumentTable::NO_ORDINAL && !documents.IsLive(2));
+    ASSERT(!documents.HasStatus(2, DocumentStatus::BANNED) && documents.GetStatus(2) == DocumentStatus::BANNED);
+    ASSERT(!documents.HasStatus(3, DocumentStatus::ACTUAL) && documents.GetTermIds(3).size() == 1);
+    assert_ids({5, 6, 4095});
+
+    // released and added again with another status: a new row, the old one stays dead
+    documents.Release(4096);
+    ASSERT(documents.Find(4096) == DocumentTable::NO_ORDINAL && documents.GetTermIds(2).empty());
+    ASSERT(documents.Add(4096, 9, DocumentStatus::IRRELEVANT, 3, {7, 8}) == 5);
+    ASSERT(documents.FindLive(4096) == 5 && documents.HasStatus(5, DocumentStatus::IRRELEVANT) && !documents.HasStatus(5, DocumentStatus::BANNED));
+    ASSERT(!documents.IsLive(2) && !documents.HasStatus(2, DocumentStatus::BANNED) && !documents.HasStatus(2, DocumentStatus::IRRELEVANT));
+    ASSERT(documents.size() == 6);
+    assert_ids({5, 6, 4095, 4096});
+
+    documents.Compact();
+    ASSERT(documents.size() == 4 && documents.Find(70000) == DocumentTable::NO_ORDINAL);
+    assert_ids({5, 6, 4095, 4096});
+
+    for (const int document_id : documents) {
+        const uint32_t ordinal = documents.FindLive(document_id);
+
+        ASSERT(ordinal != DocumentTable::NO_ORDINAL && documents.GetId(ordinal) == document_id);
+        ASSERT(documents.HasStatus(ordinal, documents.GetStatus(ordinal)));
+    }
+
+    ASSERT(documents.GetRating(documents.Find(4096)) == 9 && documents.GetTermIds(documents.Find(4096)).size() == 2);
+
+    for (const int document_id : {5, 4096, 6, 4095}) {
+        documents.MarkRemoved(documents.FindLive(document_id));
+    }
+
+    assert_ids({});
+
+    // through the server: a re-added id is found under its new status only
+    SearchServer search_server(""s);
+    search_server.AddDocument(4096, "cat"s, DocumentStatus::BANNED, {1});
+    search_server.AddDocument(4097, "cat"s, DocumentStatus::ACTUAL, {1});
+    search_server.RemoveDocument(4096);
+    ASSERT(search_server.FindTopDocuments("cat"s, DocumentStatus::BANNED).empty());
+    search_server.AddDocument(4096, "cat dog"s, DocumentStatus::ACTUAL, {2});
+    ASSERT(search_server.FindTopDocuments("cat"s, DocumentStatus::BANNED).empty() && search_server.FindTopDocuments("cat"s).size() == 2);
+    ASSERT(search_server.FindTopDocuments(std::execution::par, "cat"s).size() == 2 && std::get <1> (search_server.MatchDocument("dog"s, 4096)) == DocumentStatus::ACTUAL);
+}
+
+// Every tokenizer version must split and validate exactly like the one-char-at-a-time reference:
+// same word spans, and a control character reported exactly when some word holds one
+void TestTokenizerMatchesReference() {
+    auto reference_split = [](std::string_view text) {
+        std::vector <std::string_view> words;
+
+        while (!text.empty()) {
+            const size_t space = text.find(' ');
+
+            if (space != 0) {
+                words.push_back(text.substr(0, space));
+            }
+
+            if (space == std::string_view::npos) {
+                break;
+            }
+
+            text.remove_prefix(space + 1);
+        }
+
+        return words;
+    };
+
+    auto reference_is_valid = [](std::string_view word) {
+        return std::none_of(word.begin(), word.end(), [](char c) { return c >= '\0' && c < ' '; });
+    };
+
+    // spaces, plain letters, UTF-8 bytes, DEL and the control characters' edges
+    const std::string alphabet = "    abcxyz-\x7f\x80\xc3\xa9\xff"s;
+    const std::string control_characters = "\x00\x01\t\n\x1f"s;
+    std::mt19937 generator(53);
+    std::string buffer;
+
+    for (int text_index = 0; text_index < 20000; ++text_index) {
+        const size_t length = text_index % 50 == 0 ? generator() % 2000 : generator() % 100;
+        const bool with_control_characters = generator() % 4 == 0;
+
+        buffer.clear();
+
+        for (size_t index = 0; index < length + 32; ++index) {
+            if (with_control_characters && generator() % 64 == 0) {
+                buffer.push_back(control_characters[generator() % control_characters.size()]);
+            } else if (generator() % 16 == 0) {
+                buffer.append(generator() % 40, ' ');
+            } else {
+                buffer.push_back(alphabet[generator() % alphabet.size()]);
+            }
+        }
+
+        // a random start puts the words at every offset from a vector boundary
+        const std::string_view text = std::string_view(buffer).substr(generator() % 32, length);
+        const std::vector <std::string_view> expected_words = reference_split(text);
+        const bool expected_control = !std::all_of(expected_words.begin(), expected_words.end(), reference_is_valid);
+
+        for (const TokenizerIsa isa : {TokenizerIsa::SCALAR, TokenizerIsa::SSE2, TokenizerIsa::AVX2}) {
+            if (!IsTokenizerIsaSupported(isa)) {
+                continue;
+            }
+
+            const std::string hint = "isa "s + std::to_string(static_cast <int> (isa)) + ", text "s + std::to_string(text_index);
+            const TokenizedText tokens = TokenizeText(isa, text);
+
+            ASSERT_HINT(tokens.words.size() == expected_words.size(), hint);
+
+            for (size_t index = 0; index < tokens.words.size(); ++index) {
+                ASSERT_HINT(tokens.words[index].data() == expected_words[index].data() && tokens.words[index].size() == expected_words[index].size(), hint);
+            }
+
+            ASSERT_HINT(tokens.has_control_characters == expected_control, hint);
+            ASSERT_HINT(HasControlCharacters(isa, text) == !reference_is_valid(text), hint);
+        }
+    }
+
+    ASSERT(IsTokenizerIsaSupported(TokenizerIsa::SCALAR) && IsTokenizerIsaSupported(GetTokenizerIsa()));
+}
+
+// Scopes must rewind in stack order and keep alignment; once a workload has run, repeating it
+// must not take another block from the heap
+void TestScratchArena() {
+    ScratchArena& arena = ScratchArena::ForThisThread();
+
+    {
+        ScratchArena::Scope outer;
+        void* const first = outer.GetResource()->allocate(24, 8);
+        void* inner_first = nullptr;
+
+        {
+            ScratchArena::Scope inner;
+            inner_first = inner.GetResource()->allocate(100, 64);
+            ASSERT(reinterpret_cast <uintptr_t> (inner_first) % 64 == 0);
+            ASSERT(inner_first != first);
+
+            // bigger than any block so far: the arena grows
+            std::pmr::vector <char> large(ScratchArena::MIN_BLOCK_SIZE * 4, 'x', inner.GetResource());
+            ASSERT(large.back() == 'x');
+        }
+
+        ScratchArena::Scope inner;
+        ASSERT(inner.GetResource()->allocate(100, 64) == inner_first);
+    }
+
+    const uint64_t block_count = arena.GetBlockAllocationCount();
+    ASSERT(arena.GetCapacity() >= ScratchArena::MIN_BLOCK_SIZE * 5);
+
+    {
+        ScratchArena::Scope scope;
+        std::pmr::vector <char> large(ScratchArena::MIN_BLOCK_SIZE * 4, 'y', scope.GetResource());
+    }
+
+    ASSERT(arena.GetBlockAllocationCount() == block_count);
+
+    SearchServer search_server("and in"s);
+
+    for (int document_id = 0; document_id < 500; ++document_id) {
+        search_server.AddDocument(document_id, "cat w"s + std::to_string(document_id % 30) + " and dog in w"s + std::to_string(document_id % 7), DocumentStatus::ACTUAL, {document_id % 5});
+    }
+
+    const std::vector <std::string> queries = {"cat w1 w2 -w3"s, "dog w4"s, "w5 w6 w7 w8 w9 -cat"s};
+    auto run_queries = [&search_server, &queries]() {
+        size_t result_count = 0;
+
+        for (const std::string& query : queries) {
+            result_count += search_server.FindTopDocuments(query).size();
+            result_count += search_server.FindTopDocuments(query, SearchOptions{MAX_RESULT_DOCUMENT_COUNT, false}).size();
+            result_count += search_server.FindTopDocuments(std::execution::par, query).size();
+            result_count += std::get <0> (search_server.MatchDocument(query, 7)).size();
+        }
+
+        return result_count;
+    };
+
+    const size_t result_count = run_queries();
+    const uint64_t warm_block_count = arena.GetBlockAllocationCount();
+
+    ASSERT(run_queries() == result_count);
+    ASSERT(arena.GetBlockAllocationCount() == warm_block_count);
+}
+
+// Removed documents must vanish from results right away, reused ids must not see their old postings,
+// and compaction must not change any result while it drops the terms nobody uses any more
+void TestCompactKeepsResults() {
+    SearchServer search_server("and"s);
+
+    for (int document_id = 0; document_id < 300; ++document_id) {
+        const std::string text = "common w"s + std::to_string(document_id % 40) + " and u"s + std::to_string(document_id);
+        search_server.AddDocument(document_id, text, DocumentStatus::ACTUAL, {document_id % 7});
+    }
+
+    for (int document_id = 0; document_id < 300; document_id += 2) {
+        search_server.RemoveDocument(document_id);
+    }
+
+    search_server.RemoveDocuments({1, 3, 3, 1000});
+    search_server.AddDocument(4, "common u4 fresh"s, DocumentStatus::ACTUAL, {5});
+
+    const std::vector <std::string> queries = {"common"s, "u4 u5 u6"s, "w3 w4 -u7"s, "fresh common"s, "u0 u1"s};
+    const SearchOptions options{1000};
+    std::vector <std::vector <Document>> before_compaction;
+
+    for (const std::string& query : queries) {
+        before_compaction.push_back(search_server.FindTopDocuments(query, options));
+
+        for (const Document& document : before_compaction.back()) {
+            ASSERT_HINT(document.id == 4 || document.id % 2 == 1, "removed document "s + std::to_string(document.id) + " found by "s + query);
+        }
+    }
+
+    ASSERT(search_server.FindTopDocuments("u0 u1"s).empty());
+    ASSERT(search_server.GetDocumentCount() == 149);
+    ASSERT(search_server.GetRemovedPostingCount() > 0);
+
+    const CompactionStats stats = search_server.Compact();
+
+    ASSERT(stats.removed_postings > 0);
+    // u0, u1, u2, u3, u5, u6, ... and the twenty even w words
+    ASSERT(stats.removed_terms == 171);
+    ASSERT(stats.bytes_reclaimed > 0);
+    ASSERT(search_server.GetRemovedPostingCount() == 0);
+
+    for (size_t index = 0; index < queries.size(); ++index) {
+        const std::vector <Document> after_compaction = search_server.FindTopDocuments(std::execution::par, queries[index], options);
+        ASSERT_HINT(after_compaction.size() == before_compaction[index].size(), queries[index]);
+
+        for (size_t position = 0; position < after_compaction.size(); ++position) {
+            ASSERT(after_compaction[position].id == before_compaction[index][position].id);
+            ASSERT(after_compaction[position].relevance == before_compaction[index][position].relevance);
+        }
+    }
+
+    const auto [matched_words, status] = search_server.MatchDocument("fresh u4 w4"s, 4);
+    ASSERT(matched_words.size() == 2 && matched_words[0] == "fresh"s && matched_words[1] == "u4"s && status == DocumentStatus::ACTUAL);
+    ASSERT(search_server.GetWordFrequencies(5).count("u5"s) == 1);
+    ASSERT(search_server.Compact().removed_postings == 0);
+}
+
+// Both policies must return the document's words present in the query, sorted and unique,
+// and nothing at all once a minus word hits
+void TestMatchDocumentPolicies() {
+    std::mt19937 generator(29);
+    SearchServer search_server("w0"s);
+
+    for (int document_id = 0; document_id < 100; ++document_id) {
+        std::string text;
+
+        for (size_t word_index = 1 + generator() % 20; word_index > 0; --word_index) {
+            text += "w"s + std::to_string(generator() % 150) + " "s;
+        }
+
+        search_server.AddDocument(document_id, text, DocumentStatus::BANNED, {1});
+    }
+
+    for (int query_index = 0; query_index < 200; ++query_index) {
+        const int document_id = generator() % 100;
+        const std::map <std::string_view, double>& word_freqs = search_server.GetWordFrequencies(document_id);
+        std::set <std::string> plus_words;
+        bool has_minus_match = false;
+        std::string query;
+
+        for (size_t word_index = 1 + generator() % 120; word_index > 0; --word_index) {
+            const std::string word = "w"s + std::to_string(generator() % 150);
+
+            if (generator() % 16 == 0) {
+                has_minus_match = has_minus_match || word_freqs.count(word) > 0;
+                query += "-"s + word + " "s;
+            } else {
+                plus_words.insert(word);
+                query += word + " "s;
+            }
+        }
+
+        std::vector <std::string_view> expected_words;
+
+        for (const std::string& word : plus_words) {
+            const auto word_iter = word_freqs.find(word);
+
+            if (!has_minus_match && word_iter != word_freqs.end()) {
+                expected_words.push_back(word_iter->first);
+            }
+        }
+
+        const auto [seq_words, seq_status] = search_server.MatchDocument(std::execution::seq, query, document_id);
+        const auto [par_words, par_status] = search_server.MatchDocument(std::execution::par, query, document_id);
+
+        ASSERT_HINT(seq_words == expected_words && seq_status == DocumentStatus::BANNED, query);
+        ASSERT_HINT(par_words == expected_words && par_status == DocumentStatus::BANNED, query);
+    }
+}
+
+// Pruned evaluation must return exactly what scoring every matching document returns: same ids,
+// same order, bit-identical relevance, whatever the filter, result count, minus words and removals
+void TestPruningMatchesExhaustive() {
+    std::mt19937 generator(41);
+    SearchServer search_server("w0"s);
+
+    // skewed word frequencies and repeated texts give both long lists to skip and exact ties
+    auto next_word = [&generator]() {
+        const uint32_t rank = generator() % 60;
+        return "w"s + std::to_string(rank * rank / 4 + generator() % 3);
+    };
+
+    std::vector <std::string> texts;
+
+    for (int document_id = 0; document_id < 3000; ++document_id) {
+        if (!texts.empty() && generator() % 10 == 0) {
+            texts.push_back(texts[generator() % texts.size()]);
+        } else {
+            std::string text;
+
+            for (size_t word_index = 1 + generator() % 12; word_index > 0; --word_index) {
+                text += next_word() + " "s;
+            }
+
+            texts.push_back(text);
+        }
+
+        const DocumentStatus status = generator() % 5 == 0 ? DocumentStatus::IRRELEVANT : DocumentStatus::ACTUAL;
+        search_server.AddDocument(document_id * 3, texts.back(), status, {static_cast <int> (generator() % 3)});
+    }
+
+    for (int document_id = 0; document_id < 9000; document_id += 21) {
+        search_server.RemoveDocument(document_id);
+    }
+
+    for (int query_index = 0; query_index < 300; ++query_index) {
+        std::string query;
+
+        for (size_t word_index = 1 + generator() % 6; word_index > 0; --word_index) {
+            const std::string word = next_word();
+            query += generator() % 8 == 0 ? "-"s + word + " "s : word + " "s;
+        }
+
+        const size_t max_count = generator() % 4 == 0 ? 1 + generator() % 40 : MAX_RESULT_DOCUMENT_COUNT;
+        const SearchOptions pruned{max_count, true};
+        const SearchOptions exhaustive{max_count, false};
+        const int divisor = 2 + query_index % 5;
+        auto predicate = [divisor](int document_id, DocumentStatus, int) { return document_id % divisor != 0; };
+
+        const std::vector <std::pair <std::vector <Document>, std::vector <Document>>> results = {
+            {search_server.FindTopDocuments(query, pruned), search_server.FindTopDocuments(query, exhaustive)},
+            {search_server.FindTopDocuments(query, DocumentStatus::IRRELEVANT, pruned), search_server.FindTopDocuments(query, DocumentStatus::IRRELEVANT, exhaustive)},
+            {search_server.FindTopDocuments(query, predicate, pruned), search_server.FindTopDocuments(query, predicate, exhaustive)},
+            {search_server.FindTopDocuments(query, pruned), search_server.FindTopDocuments(std::execution::par, query, pruned)},
+        };
+
+        for (const auto& [pruned_documents, exhaustive_documents] : results) {
+            ASSERT_HINT(pruned_documents.size() == exhaustive_documents.size(), query);
+
+            for (size_t position = 0; position < pruned_documents.size(); ++position) {
+                ASSERT_HINT(pruned_documents[position].id == exhaustive_documents[position].id, query);
+                ASSERT_HINT(pruned_documents[position].relevance == exhaustive_documents[position].relevance, query);
+                ASSERT_HINT(pruned_documents[position].rating == exhaustive_documents[position].rating, query);
+            }
+        }
+    }
+
+    // a result count far past the index only bounds the heap, nothing is allocated for it up front
+    const std::vector <Document> all_documents = search_server.FindTopDocuments("w1 w2 -w9"s, SearchOptions{100000, false});
+    ASSERT(!all_documents.empty());
+
+    for (const size_t max_count : {SIZE_MAX, size_t{1} << 30}) {
+        for (const std::vector <Document>& documents : {search_server.FindTopDocuments("w1 w2 -w9"s, SearchOptions{max_count}),
+                search_server.FindTopDocuments("w1 w2 -w9"s, SearchOptions{max_count, false}), search_server.FindTopDocuments(std::execution::par, "w1 w2 -w9"s, SearchOptions{max_count})}) {
+            ASSERT(documents.size() == all_documents.size());
+
+            for (size_t position = 0; position < documents.size(); ++position) {
+                ASSERT(documents[position].id == all_documents[position].id && documents[position].relevance == all_documents[position].relevance);
+            }
+        }
+    }
+}
+
+// The status overloads answer from the table's status bits; a lambda testing the same status goes through the predicate path
+void TestStatusFilterMatchesPredicate() {
+    std::mt19937 generator(7);
+    SearchServer search_server("w0"s);
+    const std::vector <DocumentStatus> statuses = {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT, DocumentStatus::BANNED, DocumentStatus::REMOVED};
+
+    auto make_text = [&generator]() {
+        std::string text;
+
+        for (size_t word_index = 1 + generator() % 10; word_index > 0; --word_index) {
+            text += "w"s + std::to_string(generator() % 40) + " "s;
+        }
+
+        return text;
+    };
+
+    auto compare = [&search_server, &statuses](const std::string& query) {
+        for (const DocumentStatus status : statuses) {
+            auto predicate = [status](int, DocumentStatus document_status, int) { return document_status == status; };
+
+            for (const bool pruning : {true, false}) {
+                const SearchOptions options{10, pruning};
+                const std::vector <Document> filtered = search_server.FindTopDocuments(query, status, options);
+                const std::vector <Document> predicated = search_server.FindTopDocuments(query, predicate, options);
+                const std::vector <Document> parallel = search_server.FindTopDocuments(std::execution::par, query, status, options);
+
+                ASSERT_HINT(filtered.size() == predicated.size() && filtered.size() == parallel.size(), query);
+
+                for (size_t position = 0; position < filtered.size(); ++position) {
+                    ASSERT_HINT(filtered[position].id == predicated[position].id && filtered[position].id == parallel[position].id, query);
+                    ASSERT_HINT(filtered[position].relevance == predicated[position].relevance, query);
+                    ASSERT_HINT(filtered[position].rating == predicated[position].rating, query);
+                    ASSERT_HINT(std::get <1> (search_server.MatchDocument(query, filtered[position].id)) == status, query);
+                }
+            }
+        }
+    };
+
+    // ids spread over many id pages, some of them never touched
+    for (int document_id = 0; document_id < 2000; ++document_id) {
+        search_server.AddDocument(document_id * 37 + document_id % 5 * 10000, make_text(), statuses[generator() % statuses.size()], {static_cast <int> (generator() % 7)});
+    }
+
+    compare("w1 w2 w3 -w4"s);
+
+    // removed documents stop matching every status; a re-added id may come back with another status
+    for (int document_id = 0; document_id < 2000; document_id += 3) {
+        search_server.RemoveDocument(document_id * 37 + document_id % 5 * 10000);
+    }
+
+    for (int document_id = 0; document_id < 2000; document_id += 6) {
+        search_server.AddDocument(document_id * 37 + document_id % 5 * 10000, make_text(), statuses[generator() % statuses.size()], {1});
+    }
+
+    ASSERT(search_server.GetDocumentCount() == 2000 - 667 + 334);
+    compare("w5 w6 w7 w8"s);
+
+    bool is_thrown = false;
+
+    try {
+        search_server.MatchDocument("w1"s, 3 * 37 + 3 * 10000);
+    } catch (const std::out_of_range&) {
+        is_thrown = true;
+    }
+
+    ASSERT(is_thrown);
+
+    search_server.Compact();
+    ASSERT(search_server.GetDocumentCount() == 2000 - 667 + 334);
+    compare("w1 w2 w3 -w4"s);
+    compare("w9 w10 w11"s);
+}
+
+// Tiny batches push every line through all three stages; the outcome must equal adding the good lines one by one
+void TestDocumentLoader() {
+    const std::vector <std::string> lines = {
+        "1\tACTUAL\t5 -3\tfunny pet and nasty rat"s,
+        ""s,
+        "2\tBANNED\t\tcurly hair\r"s,
+        "3\tACTUAL\t1"s,
+        "4\tUNKNOWN\t1\tpet"s,
+        "5\tACTUAL\t1 x\tpet"s,
+        "x6\tACTUAL\t1\tpet"s,
+        "-7\tACTUAL\t1\tpet"s,
+        "1\tACTUAL\t1\tduplicate pet"s,
+        "8\tIRRELEVANT\t2\tcontrol \x01 pet"s,
+        "9\tIRRELEVANT\t\tnasty pet with curly hair"s,
+    };
+
+    std::string corpus;
+
+    for (int copy = 0; copy < 30; ++copy) {
+        for (const std::string& line : lines) {
+            const size_t tab = line.find('\t');
+            const std::string id = line.substr(0, tab);
+            corpus += (id == "x6"s || id.empty() ? id : std::to_string(std::stoi(id) + (std::stoi(id) < 0 ? -100 : 100) * copy)) + line.substr(tab == std::string::npos ? line.size() : tab) + "\n"s;
+        }
+    }
+
+    // no newline after the last line
+    corpus += "10000\tACTUAL\t7\tlast rat"s;
+
+    SearchServer loaded("and with"s);
+    std::istringstream input(corpus);
+    const LoadStats stats = DocumentLoader(loaded, {64, 1}).Load(input);
+
+    SearchServer expected("and with"s);
+    expected.AddDocument(10000, "last rat"s, DocumentStatus::ACTUAL, {7});
+
+    for (int copy = 0; copy < 30; ++copy) {
+        expected.AddDocument(1 + 100 * copy, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {5, -3});
+        expected.AddDocument(2 + 100 * copy, "curly hair"s, DocumentStatus::BANNED, {});
+        expected.AddDocument(9 + 100 * copy, "nasty pet with curly hair"s, DocumentStatus::IRRELEVANT, {});
+    }
+
+    ASSERT(stats.bytes_read == corpus.size());
+    ASSERT(stats.lines_read == lines.size() * 30 + 1);
+    ASSERT(stats.documents_added == 91);
+    ASSERT(loaded.GetDocumentCount() == expected.GetDocumentCount());
+
+    const std::vector <std::string> messages = {"missing fields"s, "invalid status"s, "invalid rating"s, "invalid id"s, "invalid id"s, "id duplication"s, "invalid document word"s};
+    ASSERT(stats.errors.size() == messages.size() * 30);
+
+    for (size_t index = 0; index < stats.errors.size(); ++index) {
+        ASSERT_HINT(stats.errors[index].line_number == index / messages.size() * lines.size() + 4 + index % messages.size(), stats.errors[index].message);
+        ASSERT_HINT(stats.errors[index].message == messages[index % messages.size()], stats.errors[index].message);
+    }
+
+    for (const std::string& query : {"pet"s, "curly rat -funny"s, "nasty hair last"s}) {
+        for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED, DocumentStatus::IRRELEVANT}) {
+            const std::vector <Document> loaded_documents = loaded.FindTopDocuments(query, status, {1000});
+            const std::vector <Document> expected_documents = expected.FindTopDocuments(query, status, {1000});
+
+            ASSERT_HINT(loaded_documents.size() == expected_documents.size(), query);
+
+            for (size_t position = 0; position < loaded_documents.size(); ++position) {
+                ASSERT_HINT(loaded_documents[position].id == expected_documents[position].id, query);
+                ASSERT_HINT(loaded_documents[position].relevance == expected_documents[position].relevance, query);
+                ASSERT_HINT(loaded_documents[position].rating == expected_documents[position].rating, query);
+            }
+        }
+    }
+
+    const DocumentRecord record = ParseDocumentLine("42\tREMOVED\t1 2 3\ttabs\tstay in text\r"s);
+    ASSERT(record.id == 42 && record.status == DocumentStatus::REMOVED && record.ratings == std::vector <int> ({1, 2, 3}) && record.text == "tabs\tstay in text"s);
+}
+
+// Async requests from several threads must return what the server returns and keep the window statistics exact
+void TestRequestQueueAsync() {
+    SearchServer search_server("and with"s);
+    const std::vector <std::string> texts = {"funny pet and nasty rat"s, "funny pet with curly hair"s, "big cat nasty hair"s, "big dog cat Vladislav"s};
+
+    for (int document_id = 0; document_id < 400; ++document_id) {
+        search_server.AddDocument(document_id, texts[document_id % texts.size()], document_id % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {document_id % 11 - 5});
+    }
+
+    const std::vector <std::string> queries = {"curly dog"s, "nasty rat -not"s, "not very funny nasty pet"s, "empty request"s, "big -cat"s, "sparrow"s};
+    auto positive_rating = [](int, DocumentStatus, int rating) { return rating > 0; };
+
+    {
+        RequestQueue request_queue(search_server, 4, {4, 2000});
+        std::vector <std::thread> clients;
+        std::atomic <int> mismatches{0};
+        std::atomic <int> expected_empty{0};
+
+        for (int client = 0; client < 4; ++client) {
+            clients.emplace_back([&, client]() {
+                std::vector <std::pair <std::future <std::vector <Document>>, std::vector <Document>>> requests;
+
+                for (int index = 0; index < 300; ++index) {
+                    const std::string& query = queries[(client + index) % queries.size()];
+
+                    if (index % 3 == 0) {
+                        requests.push_back({request_queue.AddFindRequestAsync(query, positive_rating), search_server.FindTopDocuments(query, positive_rating)});
+                    } else if (index % 3 == 1) {
+                        requests.push_back({request_queue.AddFindRequestAsync(query, DocumentStatus::BANNED), search_server.FindTopDocuments(query, DocumentStatus::BANNED)});
+                    } else {
+                        requests.push_back({request_queue.AddFindRequestAsync(query), search_server.FindTopDocuments(query)});
+                    }
+                }
+
+                for (auto& [future, expected] : requests) {
+                    const std::vector <Document> documents = future.get();
+                    expected_empty += expected.empty();
+
+                    if (documents.size() != expected.size() || !std::equal(documents.begin(), documents.end(), expected.begin(), [](const Document& lhs, const Document& rhs) {
+                        return lhs.id == rhs.id && lhs.relevance == rhs.relevance && lhs.rating == rhs.rating;
+                    })) {
+                        ++mismatches;
+                    }
+                }
+            });
+        }
+
+        for (std::thread& client : clients) {
+            client.join();
+        }
+
+        ASSERT(mismatches == 0);
+
+        // all 1200 requests fit in the window
+        const RequestQueue::RequestStats stats = request_queue.GetRequestStats();
+        ASSERT(stats.request_count == 1200 && expected_empty > 0);
+        ASSERT(stats.no_result_count == static_cast <size_t> (expected_empty) && request_queue.GetNoResultRequests() == expected_empty);
+        ASSERT(stats.p50_us <= stats.p90_us && stats.p90_us <= stats.p99_us && stats.p99_us <= stats.max_us && stats.max_us > 0.0);
+        ASSERT(stats.rejected_count == 0);
+
+        const RequestQueue::CacheStats cache_stats = request_queue.GetCacheStats();
+        ASSERT(cache_stats.hits + cache_stats.misses == 800);
+
+        bool is_thrown = false;
+
+        try {
+            request_queue.AddFindRequestAsync("bad \x01 query"s).get();
+        } catch (const std::invalid_argument&) {
+            is_thrown = true;
+        }
+
+        ASSERT(is_thrown);
+    }
+
+    // admission control: one busy thread and two waiting requests fill the pool, the next one is turned away
+    {
+        RequestQueue request_queue(search_server, 0, {1, 2});
+        std::promise <void> gate;
+        const std::shared_future <void> gate_opened = gate.get_future().share();
+        std::atomic <bool> is_started{false};
+
+        auto blocking_predicate = [&gate_opened, &is_started](int, DocumentStatus, int) {
+            is_started = true;
+            gate_opened.wait();
+            return true;
+        };
+
+        std::future <std::vector <Document>> blocked = request_queue.AddFindRequestAsync("funny"s, blocking_predicate);
+
+        while (!is_started) {
+            std::this_thread::yield();
+        }
+
+        std::future <std::vector <Document>> first = request_queue.AddFindRequestAsync("funny"s);
+        std::future <std::vector <Document>> second = request_queue.AddFindRequestAsync("cat"s);
+        bool is_rejected = false;
+
+        try {
+            request_queue.AddFindRequestAsync("dog"s);
+        } catch (const std::runtime_error&) {
+            is_rejected = true;
+        }
+
+        ASSERT(is_rejected);
+        gate.set_value();
+
+        ASSERT(blocked.get().size() == MAX_RESULT_DOCUMENT_COUNT && first.get().size() == MAX_RESULT_DOCUMENT_COUNT && second.get().size() == MAX_RESULT_DOCUMENT_COUNT);
+        ASSERT(request_queue.GetRequestStats().rejected_count == 1 && request_queue.GetRequestStats().request_count == 3);
+    }
+
+    // tasks spawning tasks: every one runs before the pool is gone
+    std::atomic <int> completed{0};
+
+    {
+        ThreadPool pool(3, 10000);
+
+        for (int task = 0; task < 100; ++task) {
+            ASSERT(pool.TrySubmit([&pool, &completed]() {
+                for (int child = 0; child < 10; ++child) {
+                    pool.TrySubmit([&completed]() { ++completed; });
+                }
+
+                ++completed;
+            }));
+        }
+    }
+
+    ASSERT(completed == 1100);
+}
+
+// A sharded server must rank exactly like one server holding all the documents: same ids, same order, same relevance
+void TestShardedSearchServer() {
+    std::mt19937 generator(41);
+    SearchServer search_server("w0 w1"s);
+    ShardedSearchServer sharded_search_server(5, "w0 w1"s);
+
+    for (int document_id = 0; document_id < 400; ++document_id) {
+        std::string text;
+
+        for (size_t word_index = 1 + generator() % 10; word_index > 0; --word_index) {
+            text += "w"s + std::to_string(generator() % 80) + " "s;
+        }
+
+        const DocumentStatus status = generator() % 4 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        const std::vector <int> ratings = {static_cast <int> (generator() % 10)};
+
+        search_server.AddDocument(document_id, text, status, ratings);
+        sharded_search_server.AddDocument(document_id, text, status, ratings);
+    }
+
+    for (int document_id = 0; document_id < 400; document_id += 7) {
+        search_server.RemoveDocument(document_id);
+        sharded_search_server.RemoveDocument(document_id);
+    }
+
+    ASSERT(sharded_search_server.GetDocumentCount() == search_server.GetDocumentCount());
+
+    for (int query_index = 0; query_index < 100; ++query_index) {
+        std::string query;
+
+        for (size_t word_index = 1 + generator() % 6; word_index > 0; --word_index) {
+            query += (generator() % 8 == 0 ? "-w"s : "w"s) + std::to_string(generator() % 90) + " "s;
+        }
+
+        const SearchOptions options{1 + generator() % 30};
+        const std::vector <Document> expected = search_server.FindTopDocuments(query, options);
+        const std::vector <Document> found = sharded_search_server.FindTopDocuments(query, options);
+
+        ASSERT_HINT(found.size() == expected.size(), query);
+
+        for (size_t position = 0; position < found.size(); ++position) {
+            ASSERT_HINT(found[position].id == expected[position].id && found[position].relevance == expected[position].relevance, query);
+        }
+
+        ASSERT(sharded_search_server.FindTopDocuments(query, DocumentStatus::BANNED, options).size() == search_server.FindTopDocuments(query, DocumentStatus::BANNED, options).size());
+    }
+
+    ASSERT(std::get <0> (sharded_search_server.MatchDocument("w2 w3 w4"s, 3)) == std::get <0> (search_server.MatchDocument("w2 w3 w4"s, 3)));
+}
+
+// 16 readers query while one writer keeps adding, removing and compacting. Every snapshot must be
+// internally consistent: each document has the word "common", so a query for it finds all of them.
+// Meant to be run under ThreadSanitizer as well.
+void TestConcurrentSearchServerStress() {
+    ConcurrentSearchServer search_server("and"s);
+    std::atomic <bool> is_writing{true};
+    std::atomic <size_t> checked_snapshots{0};
+
+    std::thread writer([&]() {
+        for (int document_id = 0; document_id < 600; ++document_id) {
+            search_server.AddDocument(document_id, "common and w"s + std::to_string(document_id % 17), DocumentStatus::ACTUAL, {document_id % 5});
+
+            if (document_id % 3 == 2) {
+                search_server.RemoveDocument(document_id - 1);
+            }
+
+            if (document_id % 200 == 199) {
+                search_server.Compact();
+            }
+        }
+
+        is_writing = false;
+    });
+
+    std::vector <std::thread> readers;
+
+    for (int reader = 0; reader < 16; ++reader) {
+        readers.emplace_back([&, reader]() {
+            do {
+                const ConcurrentSearchServer::Snapshot snapshot = search_server.AcquireSnapshot();
+                const std::vector <Document> documents = snapshot->FindTopDocuments("common w"s + std::to_string(reader), SearchOptions{1000});
+
+                ASSERT(documents.size() == static_cast <size_t> (snapshot->GetDocumentCount()));
+
+                for (const Document& document : documents) {
+                    ASSERT(!std::get <0> (snapshot->MatchDocument("common"s, document.id)).empty());
+                }
+
+                ++checked_snapshots;
+            } while (is_writing);
+        });
+    }
+
+    writer.join();
+
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+
+    ASSERT(search_server.GetDocumentCount() == 400);
+    ASSERT(search_server.FindTopDocuments("common"s, SearchOptions{1000}).size() == 400);
+    ASSERT(checked_snapshots >= 16);
+}
+
+// Quantiles must stay within the 12.5% bucket width, totals of exited threads must not be lost,
+// and with SEARCH_SERVER_METRICS every query must show up in the stage histograms
+void TestMetricsRegistry() {
+    MetricsRegistry& registry = MetricsRegistry::Instance();
+    registry.Reset();
+
+    for (uint64_t value = 1; value <= 1000; ++value) {
+        ASSERT(MetricsRegistry::GetBucketUpperBound(MetricsRegistry::GetBucketIndex(value)) >= value);
+        ASSERT(MetricsRegistry::GetBucketUpperBound(MetricsRegistry::GetBucketIndex(value)) <= value + value / 8);
+    }
+
+    ASSERT(MetricsRegistry::GetBucketIndex(UINT64_MAX) == MetricsRegistry::BUCKET_COUNT - 1);
+
+    std::vector <std::thread> threads;
+
+    for (int thread = 0; thread < 4; ++thread) {
+        threads.emplace_back([&registry]() {
+            for (uint64_t value = 1; value <= 1000; ++value) {
+                registry.Record(MetricHistogram::POSTINGS_PER_QUERY, value);
+                registry.Add(MetricCounter::POSTINGS_SCANNED, value);
+            }
+        });
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    const MetricsSnapshot snapshot = registry.TakeSnapshot();
+    const HistogramSummary& summary = snapshot.GetHistogram(MetricHistogram::POSTINGS_PER_QUERY);
+
+    ASSERT(snapshot.GetCounter(MetricCounter::POSTINGS_SCANNED) == 4 * 500500);
+    ASSERT(summary.count == 4000 && summary.sum == 4 * 500500 && summary.max == 1000);
+    ASSERT(summary.p50 >= 500 && summary.p50 <= 500 + 500 / 8);
+    ASSERT(summary.p99 >= 990 && summary.p999 <= 1000);
+
+    registry.Reset();
+    ASSERT(registry.TakeSnapshot().GetHistogram(MetricHistogram::POSTINGS_PER_QUERY).count == 0);
+
+#ifdef SEARCH_SERVER_METRICS
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "cat and dog"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "dog"s, DocumentStatus::ACTUAL, {1});
+    search_server.FindTopDocuments("dog -cat"s);
+    search_server.FindTopDocuments(std::execution::par, "dog cat"s);
+
+    const MetricsSnapshot query_snapshot = registry.TakeSnapshot();
+
+    ASSERT(query_snapshot.GetCounter(MetricCounter::QUERIES) == 2);
+    ASSERT(query_snapshot.GetCounter(MetricCounter::POSTINGS_SCANNED) == 2 + 3);
+    ASSERT(query_snapshot.GetCounter(MetricCounter::DOCUMENTS_MATCHED) == 1 + 2);
+
+    for (const MetricHistogram stage : {MetricHistogram::QUERY_TOTAL, MetricHistogram::QUERY_VALIDATION, MetricHistogram::QUERY_PARSE,
+            MetricHistogram::QUERY_ACCUMULATION, MetricHistogram::QUERY_MINUS_FILTER, MetricHistogram::QUERY_RANKING}) {
+        ASSERT_HINT(query_snapshot.GetHistogram(stage).count == 2, GetMetricName(stage));
+    }
+#endif
+}
+
+// Pages of a cursor joined together equal one ranking of every match, through ties, skips,
+// search-after from an outside position and changes of the server between pages
+void TestSearchCursor() {
+    {
+        const std::vector <int> numbers = {1, 2, 3, 4, 5};
+        std::ostringstream output;
+
+        for (const auto& page : Paginate(numbers, 2)) {
+            output << page << "|"s;
+        }
+
+        ASSERT(Paginate(numbers, 2).size() == 3);
+        ASSERT(Paginate(numbers, 5).size() == 1);
+        ASSERT(Paginate(std::vector <int> (), 3).size() == 0);
+        ASSERT_HINT(output.str() == "12|34|5|"s, output.str());
+
+        bool is_thrown = false;
+
+        try {
+            Paginate(numbers, 0);
+        } catch (const std::invalid_argument&) {
+            is_thrown = true;
+        }
+
+        ASSERT(is_thrown);
+    }
+
+    std::mt19937 generator(23);
+    SearchServer search_server("w0"s);
+
+    // few words and ratings, so many documents tie on relevance and rating
+    for (int document_id = 0; document_id < 3000; ++document_id) {
+        std::string text;
+
+        for (size_t word_index = 1 + generator() % 4; word_index > 0; --word_index) {
+            text += "w"s + std::to_string(generator() % 8) + " "s;
+        }
+
+        search_server.AddDocument(document_id * 3, text, document_id % 4 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {static_cast <int> (generator() % 3)});
+    }
+
+    auto assert_same = [](const std::vector <Document>& lhs, const std::vector <Document>& rhs, const std::string& hint) {
+        ASSERT_HINT(lhs.size() == rhs.size(), hint);
+
+        for (size_t position = 0; position < lhs.size(); ++position) {
+            ASSERT_HINT(lhs[position].id == rhs[position].id && lhs[position].relevance == rhs[position].relevance, hint);
+        }
+    };
+
+    auto read_all = [](auto& cursor) {
+        std::vector <Document> documents;
+
+        for (std::vector <Document> page = cursor.NextPage(); !page.empty(); page = cursor.NextPage()) {
+            ASSERT(page.size() <= cursor.GetPageSize());
+            documents.insert(documents.end(), page.begin(), page.end());
+        }
+
+        ASSERT(cursor.IsExhausted());
+
+        return documents;
+    };
+
+    const std::string query = "w1 w2 -w3"s;
+    const std::vector <Document> expected = search_server.FindTopDocuments(query, SearchOptions{10000, false});
+    ASSERT(expected.size() > 500);
+
+    for (const size_t page_size : {1u, 7u, 10u, 1000u, 5000u}) {
+        auto cursor = OpenCursor(search_server, query, page_size);
+        assert_same(read_all(cursor), expected, std::to_string(page_size));
+    }
+
+    {
+        auto predicate = [](int document_id, DocumentStatus, int) { return document_id % 2 == 0; };
+        auto cursor = OpenCursor(search_server, query, predicate, 13);
+        assert_same(read_all(cursor), search_server.FindTopDocuments(query, predicate, SearchOptions{10000, false}), "predicate"s);
+    }
+
+    // page 40 directly, and search-after from a document of a page shown earlier
+    {
+        auto cursor = OpenCursor(search_server, query, 10);
+        cursor.Skip(390);
+        const std::vector <Document> page = cursor.NextPage();
+        assert_same(page, std::vector <Document> (expected.begin() + 390, expected.begin() + 400), "skip"s);
+
+        cursor.SeekAfter(expected[99]);
+        assert_same(cursor.NextPage(), std::vector <Document> (expected.begin() + 100, expected.begin() + 110), "seek"s);
+
+        for (const bool pruning : {true, false}) {
+            SearchOptions options{10, pruning};
+            options.search_after = expected[249];
+            assert_same(search_server.FindTopDocuments(query, options), std::vector <Document> (expected.begin() + 250, expected.begin() + 260), "search after"s);
+            assert_same(search_server.FindTopDocuments(std::execution::par, query, options), std::vector <Document> (expected.begin() + 250, expected.begin() + 260), "par search after"s);
+        }
+    }
+
+    // a skip far past the end walks the results in bounded evaluations and exhausts the cursor
+    {
+        auto cursor = OpenCursor(search_server, query, 3);
+        cursor.Skip(expected.size() - 2);
+        ASSERT(!cursor.IsExhausted() && cursor.GetPosition()->id == expected[expected.size() - 3].id);
+        assert_same(cursor.NextPage(), std::vector <Document> (expected.end() - 2, expected.end()), "skip to the end"s);
+        ASSERT(cursor.IsExhausted());
+
+        auto far_cursor = OpenCursor(search_server, query, 1);
+        far_cursor.Skip(size_t{1} << 30);
+        ASSERT(far_cursor.IsExhausted() && far_cursor.GetPosition()->id == expected.back().id);
+        ASSERT(far_cursor.NextPage().empty());
+
+        auto empty_cursor = OpenCursor(search_server, "nothing"s, 10);
+        empty_cursor.Skip(SIZE_MAX);
+        ASSERT(empty_cursor.IsExhausted() && !empty_cursor.GetPosition().has_value());
+    }
+
+    // a change between pages: the next page continues after the last document handed out, ranked by the new index
+    {
+        auto cursor = OpenCursor(search_server, query, DocumentStatus::ACTUAL, 25);
+        std::vector <Document> documents = cursor.NextPage();
+        const Document last = documents.back();
+
+        search_server.AddDocument(100000, "w1 w2 w2"s, DocumentStatus::ACTUAL, {9});
+        search_server.RemoveDocument(expected[30].id);
+
+        SearchOptions options{10000, false};
+        options.search_after = last;
+        assert_same(read_all(cursor), search_server.FindTopDocuments(query, options), "changed"s);
+    }
+
+    bool is_thrown = false;
+
+    try {
+        OpenCursor(search_server, "w1 \x01"s, 10);
+    } catch (const std::invalid_argument&) {
+        is_thrown = true;
+    }
+
+    ASSERT(is_thrown);
+}
+
+// A prepared query gives the raw query's results bit for bit, on the server it was prepared by,
+// after that server has changed or been compacted, and on another server with the same stop words
+void TestPreparedQuery() {
+    std::mt19937 generator(29);
+
+    auto make_server = [&generator]() {
+        SearchServer search_server("and in"s);
+
+        for (int document_id = 0; document_id < 1500; ++document_id) {
+            std::string text;
+
+            for (size_t word_index = 1 + generator() % 8; word_index > 0; --word_index) {
+                text += (generator() % 10 == 0 ? "and"s : "w"s + std::to_string(generator() % 30)) + " "s;
+            }
+
+            search_server.AddDocument(document_id * 2, text, document_id % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {static_cast <int> (generator() % 5)});
+        }
+
+        return search_server;
+    };
+
+    auto assert_same = [](const std::vector <Document>& lhs, const std::vector <Document>& rhs, const std::string& hint) {
+        ASSERT_HINT(lhs.size() == rhs.size(), hint);
+
+        for (size_t position = 0; position < lhs.size(); ++position) {
+            ASSERT_HINT(lhs[position].id == rhs[position].id && lhs[position].relevance == rhs[position].relevance && lhs[position].rating == rhs[position].rating, hint);
+        }
+    };
+
+    const std::vector <std::string> raw_queries = {"w1 w2 w3"s, "w4 -w5 and w4"s, "w6 w7 w8 w9 -w1 -w2"s, "w30 w31"s, "-w3"s, ""s};
+
+    auto compare = [&](const SearchServer& search_server, const std::vector <PreparedQuery>& queries) {
+        auto predicate = [](int document_id, DocumentStatus, int rating) { return document_id % 4 != 0 && rating > 0; };
+
+        for (size_t index = 0; index < raw_queries.size(); ++index) {
+            const std::string& raw_query = raw_queries[index];
+            const PreparedQuery& query = queries[index];
+
+            for (const bool pruning : {true, false}) {
+                const SearchOptions options{20, pruning};
+
+                assert_same(search_server.FindTopDocuments(query, options), search_server.FindTopDocuments(raw_query, options), raw_query);
+                assert_same(search_server.FindTopDocuments(query, DocumentStatus::BANNED, options), search_server.FindTopDocuments(raw_query, DocumentStatus::BANNED, options), raw_query);
+                assert_same(search_server.FindTopDocuments(query, predicate, options), search_server.FindTopDocuments(raw_query, predicate, options), raw_query);
+                assert_same(search_server.FindTopDocuments(std::execution::par, query, options), search_server.FindTopDocuments(raw_query, options), raw_query);
+            }
+
+            for (int document_id = 0; document_id < 3000; document_id += 97) {
+                if (search_server.GetWordFrequencies(document_id).empty()) {
+                    continue;
+                }
+
+                const auto expected = search_server.MatchDocument(raw_query, document_id);
+                ASSERT_HINT(search_server.MatchDocument(query, document_id) == expected, raw_query);
+                ASSERT_HINT(search_server.MatchDocument(std::execution::par, query, document_id) == expected, raw_query);
+            }
+        }
+    };
+
+    SearchServer search_server = make_server();
+    std::vector <PreparedQuery> queries;
+
+    for (const std::string& raw_query : raw_queries) {
+        queries.push_back(search_server.Prepare(raw_query));
+    }
+
+    ASSERT((queries[1].GetPlusWords() == std::vector <std::string> {"w4"s}));
+    ASSERT((queries[1].GetMinusWords() == std::vector <std::string> {"w5"s}));
+    ASSERT(queries[5].GetPlusWords().empty() && queries[5].GetMinusWords().empty());
+    compare(search_server, queries);
+
+    // stale: the IDFs and term ids have moved
+    search_server.AddDocument(100001, "w1 w30 w30"s, DocumentStatus::ACTUAL, {7});
+
+    for (int document_id = 0; document_id < 3000; document_id += 6) {
+        search_server.RemoveDocument(document_id);
+    }
+
+    compare(search_server, queries);
+    search_server.Compact();
+    compare(search_server, queries);
+
+    // a query prepared elsewhere, and one that never was
+    const SearchServer other_server = make_server();
+    compare(other_server, queries);
+    ASSERT(search_server.FindTopDocuments(PreparedQuery()).empty());
+
+    for (const std::string& raw_query : {"w1 \x02"s, "w1 --w2"s, "w1 -"s}) {
+        bool is_thrown = false;
+
+        try {
+            search_server.Prepare(raw_query);
+        } catch (const std::invalid_argument&) {
+            is_thrown = true;
+        }
+
+        ASSERT_HINT(is_thrown, raw_query);
+    }
+}
+
+// Results in query order, one FindTopDocuments call's worth each; the joined range walks them flat
+void TestProcessQueries() {
+    SearchServer search_server("and with"s);
+    const std::vector <std::string> texts = {"funny pet and nasty rat"s, "funny pet with curly hair"s, "funny pet and not very nasty rat"s,
+        "pet with rat and rat and rat"s, "nasty rat with curly hair"s};
+
+    for (size_t index = 0; index < texts.size(); ++index) {
+        search_server.AddDocument(static_cast <int> (index) + 1, texts[index], DocumentStatus::ACTUAL, {1, 2});
+    }
+
+    // the second and fourth queries find nothing
+    const std::vector <std::string> queries = {"nasty rat -not"s, "dog"s, "curly hair"s, "-pet"s, "funny pet"s, "rat"s};
+    const std::vector <std::vector <Document>> results = ProcessQueries(search_server, queries);
+    std::vector <Document> expected_joined;
+
+    ASSERT(results.size() == queries.size());
+
+    for (size_t index = 0; index < queries.size(); ++index) {
+        const std::vector <Document> expected = search_server.FindTopDocuments(queries[index]);
+        ASSERT_HINT(results[index].size() == expected.size(), queries[index]);
+
+        for (size_t position = 0; position < expected.size(); ++position) {
+            ASSERT_HINT(results[index][position].id == expected[position].id && results[index][position].relevance == expected[position].relevance, queries[index]);
+        }
+
+        expected_joined.insert(expected_joined.end(), expected.begin(), expected.end());
+    }
+
+    ASSERT(results[1].empty() && results[3].empty() && !results[0].empty());
+
+    const JoinedDocuments joined = ProcessQueriesJoined(search_server, queries);
+    ASSERT(joined.size() == expected_joined.size() && !joined.empty());
+
+    size_t position = 0;
+
+    for (const Document& document : joined) {
+        ASSERT(position < expected_joined.size());
+        ASSERT(document.id == expected_joined[position].id && document.relevance == expected_joined[position].relevance);
+        ++position;
+    }
+
+    ASSERT(position == expected_joined.size());
+
+    // empty results at the edges too
+    const JoinedDocuments edges = ProcessQueriesJoined(search_server, {"dog"s, "curly"s, "cat"s});
+    ASSERT(edges.size() == 2 && std::distance(edges.begin(), edges.end()) == 2);
+    ASSERT(ProcessQueriesJoined(search_server, {"dog"s}).empty());
+    ASSERT(ProcessQueries(search_server, {}).empty());
+
+    for (const std::vector <std::string>& invalid_queries : {std::vector <std::string> {"rat"s, "nasty --rat"s, "pet"s}, std::vector <std::string> {"rat \x01"s}}) {
+        size_t thrown_count = 0;
+
+        try {
+            ProcessQueries(search_server, invalid_queries);
+        } catch (const std::invalid_argument&) {
+            ++thrown_count;
+        }
+
+        try {
+            ProcessQueriesJoined(search_server, invalid_queries);
+        } catch (const std::invalid_argument&) {
+            ++thrown_count;
+        }
+
+        ASSERT(thrown_count == 2);
+    }
+}
+
+// Hits by normalized query and status, staleness by modification count, LRU eviction, and predicates past the cache
+void TestRequestQueueCache() {
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "white cat and fancy collar"s, DocumentStatus::ACTUAL, {8});
+    search_server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {7});
+    search_server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::BANNED, {5});
+
+    RequestQueue request_queue(search_server, 2);
+
+    auto assert_stats = [](const RequestQueue& queue, size_t hits, size_t misses, size_t evictions, const std::string& hint) {
+        const RequestQueue::CacheStats stats = queue.GetCacheStats();
+        ASSERT_HINT(stats.hits == hits && stats.misses == misses && stats.evictions == evictions, hint);
+    };
+
+    auto assert_ids = [](const std::vector <Document>& documents, const std::vector <int>& ids) {
+        ASSERT(documents.size() == ids.size());
+
+        for (size_t position = 0; position < ids.size(); ++position) {
+            ASSERT(documents[position].id == ids[position]);
+        }
+    };
+
+    assert_ids(request_queue.AddFindRequest("fluffy cat -dog"s), {2, 1});
+    assert_stats(request_queue, 0, 1, 0, "first"s);
+    // reordered, duplicated and stop words: the same normalized query
+    assert_ids(request_queue.AddFindRequest("-dog cat and fluffy fluffy -dog"s), {2, 1});
+    assert_stats(request_queue, 1, 1, 0, "normalized"s);
+    // the status is part of the key
+    assert_ids(request_queue.AddFindRequest("fluffy cat -dog"s, DocumentStatus::BANNED), {});
+    assert_stats(request_queue, 1, 2, 0, "status"s);
+
+    // any change to the server makes every entry stale
+    search_server.AddDocument(4, "fluffy fluffy fluffy cat"s, DocumentStatus::ACTUAL, {1});
+    assert_ids(request_queue.AddFindRequest("cat fluffy -dog"s), {4, 2, 1});
+    assert_stats(request_queue, 1, 3, 0, "after add"s);
+    assert_ids(request_queue.AddFindRequest("cat fluffy -dog"s), {4, 2, 1});
+    assert_stats(request_queue, 2, 3, 0, "cached after add"s);
+
+    search_server.RemoveDocument(4);
+    assert_ids(request_queue.AddFindRequest("cat fluffy -dog"s), {2, 1});
+    assert_stats(request_queue, 2, 4, 0, "after remove"s);
+
+    // capacity 2: the least recently used entry goes first
+    RequestQueue lru_queue(search_server, 2);
+
+    lru_queue.AddFindRequest("collar"s);
+    lru_queue.AddFindRequest("cat fluffy -dog"s);
+    assert_stats(lru_queue, 0, 2, 0, "fill"s);
+    lru_queue.AddFindRequest("collar"s);
+    assert_stats(lru_queue, 1, 2, 0, "touch collar"s);
+    lru_queue.AddFindRequest("tail"s);
+    assert_stats(lru_queue, 1, 3, 1, "the fluffy query evicted"s);
+    lru_queue.AddFindRequest("collar"s);
+    assert_stats(lru_queue, 2, 3, 1, "collar kept"s);
+    lru_queue.AddFindRequest("cat fluffy -dog"s);
+    assert_stats(lru_queue, 2, 4, 2, "fluffy again, tail evicted"s);
+    lru_queue.AddFindRequest("tail"s);
+    assert_stats(lru_queue, 2, 5, 3, "tail again, collar evicted"s);
+    lru_queue.AddFindRequest("cat fluffy -dog"s);
+    assert_stats(lru_queue, 3, 5, 3, "fluffy kept"s);
+
+    // predicates cannot be keyed, so they never touch the cache
+    assert_ids(request_queue.AddFindRequest("collar"s, [](int, DocumentStatus, int rating) { return rating > 7; }), {1});
+    assert_ids(request_queue.AddFindRequest("collar"s, [](int, DocumentStatus, int rating) { return rating < 7; }), {});
+    assert_stats(request_queue, 2, 4, 0, "predicate"s);
+
+    ASSERT(request_queue.GetNoResultRequests() == 2);
+}
+
+// A reloaded snapshot must answer every query exactly like the server it was saved from, also
+// after both are changed alike and after its file is replaced, and a damaged, cut or
+// foreign-version file must be rejected instead of loaded
+void TestSnapshot() {
+    const std::string path = "test_snapshot.bin"s;
+    const std::string damaged_path = "test_snapshot_damaged.bin"s;
+    SearchServer search_server("and in"s);
+
+    for (int document_id = 0; document_id < 400; ++document_id) {
+        const std::string text = "common w"s + std::to_string(document_id % 50) + " and u"s + std::to_string(document_id) + (document_id % 3 == 0 ? " w7 w7"s : ""s);
+        search_server.AddDocument(document_id, text, static_cast <DocumentStatus> (document_id % 3), {document_id % 11, -document_id % 5});
+    }
+
+    for (int document_id = 0; document_id < 400; document_id += 5) {
+        search_server.RemoveDocument(document_id);
+    }
+
+    // an id reused after removal must not bring back its old postings
+    search_server.AddDocument(10, "common reused w3"s, DocumentStatus::ACTUAL, {9});
+
+    const std::vector <std::string> queries = {"common"s, "w7 u10 u11"s, "w3 w4 -u13"s, "reused common"s, "u0 u5 u10"s, "w7 -common"s};
+
+    auto assert_same_results = [&queries](SearchServer& expected, SearchServer& loaded) {
+        ASSERT(loaded.GetDocumentCount() == expected.GetDocumentCount());
+        ASSERT(std::equal(loaded.begin(), loaded.end(), expected.begin(), expected.end()));
+
+        for (const std::string& query : queries) {
+            for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT, DocumentStatus::BANNED}) {
+                const std::vector <Document> expected_documents = expected.FindTopDocuments(query, status, {1000});
+                const std::vector <Document> loaded_documents = loaded.FindTopDocuments(query, status, {1000});
+                const std::vector <Document> parallel_documents = loaded.FindTopDocuments(std::execution::par, query, status, {1000});
+
+                ASSERT_HINT(loaded_documents.size() == expected_documents.size() && parallel_documents.size() == expected_documents.size(), query);
+
+                for (size_t position = 0; position < loaded_documents.size(); ++position) {
+                    ASSERT_HINT(loaded_documents[position].id == expected_documents[position].id, query);
+                    ASSERT_HINT(loaded_documents[position].relevance == expected_documents[position].relevance, query);
+                    ASSERT_HINT(loaded_documents[position].rating == expected_documents[position].rating, query);
+                    ASSERT_HINT(parallel_documents[position].id == expected_documents[position].id, query);
+                    ASSERT_HINT(parallel_documents[position].relevance == expected_documents[position].relevance, query);
+                }
+            }
+        }
+
+        for (const int document_id : expected) {
+            ASSERT(loaded.GetWordFrequencies(document_id) == expected.GetWordFrequencies(document_id));
+            ASSERT(loaded.MatchDocument("common reused w7 u"s + std::to_string(document_id), document_id) == expected.MatchDocument("common reused w7 u"s + std::to_string(document_id), document_id));
+        }
+    };
+
+    search_server.SaveSnapshot(path);
+    SearchServer loaded = SearchServer::LoadSnapshot(path);
+    assert_same_results(search_server, loaded);
+    // the postings and forward lists stay in the mapping
+    ASSERT(loaded.GetIndexByteSize() < search_server.GetIndexByteSize());
+
+    const SearchServer reloaded = SearchServer::LoadSnapshot(path);
+    ASSERT(reloaded.FindTopDocuments("u0 u5 u10"s).empty());
+    ASSERT(reloaded.FindTopDocuments("reused"s).size() == 1 && reloaded.FindTopDocuments("reused"s)[0].id == 10);
+    ASSERT(reloaded.FindTopDocuments("in"s).empty());
+
+    search_server.Compact();
+    search_server.SaveSnapshot(path);
+    loaded = SearchServer::LoadSnapshot(path);
+    assert_same_results(search_server, loaded);
+
+    // saved over while mapped: the older server keeps reading the file it was loaded from
+    ASSERT(reloaded.FindTopDocuments("reused"s).size() == 1 && reloaded.FindTopDocuments("w3"s).size() == search_server.FindTopDocuments("w3"s).size());
+
+    for (SearchServer* server : {&search_server, &loaded}) {
+        server->AddDocument(1000, "common w7 fresh"s, DocumentStatus::ACTUAL, {4});
+        server->AddDocument(5, "w3 reused again"s, DocumentStatus::BANNED, {1});
+        server->RemoveDocuments({10, 11, 399});
+    }
+
+    assert_same_results(search_server, loaded);
+    ASSERT(loaded.FindTopDocuments("fresh"s).size() == 1 && loaded.GetDocumentWords(5).size() == 3);
+
+    search_server.Compact();
+    loaded.Compact();
+    assert_same_results(search_server, loaded);
+
+    std::string bytes;
+    {
+        std::ifstream input(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator <char> (input), std::istreambuf_iterator <char> ());
+    }
+
+    auto assert_rejected = [&damaged_path](const std::string& file_bytes, const std::string& message) {
+        std::ofstream(damaged_path, std::ios::binary | std::ios::trunc).write(file_bytes.data(), file_bytes.size());
+
+        std::string error;
+
+        try {
+            SearchServer::LoadSnapshot(damaged_path);
+        } catch (const std::invalid_argument& exception) {
+            error = exception.what();
+        }
+
+        ASSERT_HINT(error.rfind(message, 0) == 0, error);
+    };
+
+    std::string flipped = bytes;
+    flipped[sizeof(SnapshotHeader) + (bytes.size() - sizeof(SnapshotHeader)) / 2] ^= 0x10;
+    assert_rejected(flipped, "snapshot checksum mismatch"s);
+
+    assert_rejected(bytes.substr(0, bytes.size() - 8), "truncated snapshot"s);
+    assert_rejected(bytes.substr(0, sizeof(SnapshotHeader) / 2), "truncated snapshot"s);
+
+    std::string other_version = bytes;
+    const uint32_t version = SNAPSHOT_VERSION + 1;
+    std::memcpy(other_version.data() + offsetof(SnapshotHeader, version), &version, sizeof(version));
+    assert_rejected(other_version, "unsupported snapshot version"s);
+
+    std::ofstream(damaged_path, std::ios::binary | std::ios::trunc).write(bytes.data(), bytes.size());
+    ASSERT(SearchServer::LoadSnapshot(damaged_path).GetDocumentCount() == SearchServer::LoadSnapshot(path).GetDocumentCount());
+    std::remove(damaged_path.c_str());
+    std::remove(path.c_str());
+}
+
+// A batch must end up exactly like a loop of AddDocument over the same records: the same errors,
+// results and dictionary, with no word of a rejected document left behind
+void TestAddDocumentsMatchesLoop() {
+    auto make_server = [] {
+        SearchServer search_server("and the"s);
+
+        for (int document_id = 0; document_id < 40; ++document_id) {
+            search_server.AddDocument(document_id, "old w"s + std::to_string(document_id % 6) + " o"s + std::to_string(document_id), DocumentStatus::ACTUAL, {document_id});
+        }
+
+        search_server.RemoveDocuments({3, 4, 5});
+        return search_server;
+    };
+
+    std::vector <DocumentRecord> records;
+
+    for (int record = 0; record < 1200; ++record) {
+        const int document_id = record % 97 == 0 ? -record : (record % 89 == 0 ? record % 40 : 40 + record % 1100);
+        std::string text = "new w"s + std::to_string(record % 6) + " and n"s + std::to_string(record % 300);
+
+        if (record >= 1100) {
+            text += " dup"s + std::to_string(record);
+        }
+
+        if (record % 101 == 0) {
+            text += " bad\x02"s + std::to_string(record);
+        }
+
+        records.push_back({document_id, text, static_cast <DocumentStatus> (record % 3), {record % 13, 1}});
+    }
+
+    // removed ids come back with their new text only
+    records.push_back({4, "reborn w1"s, DocumentStatus::ACTUAL, {2}});
+
+    SearchServer looped = make_server();
+    std::vector <DocumentError> loop_errors;
+
+    for (size_t index = 0; index < records.size(); ++index) {
+        try {
+            looped.AddDocument(records[index].id, records[index].text, records[index].status, records[index].ratings);
+        } catch (const std::invalid_argument& exception) {
+            loop_errors.push_back({index, records[index].id, exception.what()});
+        }
+    }
+
+    SearchServer batched = make_server();
+    const std::vector <DocumentError> batch_errors = batched.AddDocuments(records);
+
+    ASSERT(!loop_errors.empty());
+    ASSERT(batch_errors.size() == loop_errors.size());
+
+    for (size_t position = 0; position < batch_errors.size(); ++position) {
+        ASSERT(batch_errors[position].index == loop_errors[position].index);
+        ASSERT(batch_errors[position].document_id == loop_errors[position].document_id);
+        ASSERT_HINT(batch_errors[position].message == loop_errors[position].message, batch_errors[position].message);
+    }
+
+    ASSERT(batched.GetDocumentCount() == looped.GetDocumentCount());
+    ASSERT(std::equal(batched.begin(), batched.end(), looped.begin(), looped.end()));
+
+    for (const int document_id : looped) {
+        ASSERT(batched.GetWordFrequencies(document_id) == looped.GetWordFrequencies(document_id));
+    }
+
+    for (const std::string& query : {"new"s, "w1 n7 -old"s, "reborn o4 o5"s, "dup1100 dup1150"s, "old n299"s}) {
+        for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT, DocumentStatus::BANNED}) {
+            const std::vector <Document> batch_documents = batched.FindTopDocuments(query, status, {2000});
+            const std::vector <Document> loop_documents = looped.FindTopDocuments(query, status, {2000});
+
+            ASSERT_HINT(batch_documents.size() == loop_documents.size(), query);
+
+            for (size_t position = 0; position < batch_documents.size(); ++position) {
+                ASSERT_HINT(batch_documents[position].id == loop_documents[position].id, query);
+                ASSERT_HINT(batch_documents[position].relevance == loop_documents[position].relevance, query);
+                ASSERT_HINT(batch_documents[position].rating == loop_documents[position].rating, query);
+            }
+        }
+    }
+
+    // a batch with nothing accepted changes nothing at all
+    const uint64_t modification_count = batched.GetModificationCount();
+    ASSERT(batched.AddDocuments({{-1, "ghost"s, DocumentStatus::ACTUAL, {}}, {7, "ghost twin"s, DocumentStatus::ACTUAL, {}}}).size() == 2);
+    ASSERT(batched.GetModificationCount() == modification_count);
+
+    // only the removed documents' words go, none of the rejected ones were ever interned
+    const CompactionStats batch_stats = batched.Compact();
+    const CompactionStats loop_stats = looped.Compact();
+    ASSERT(batch_stats.removed_terms == loop_stats.removed_terms);
+    ASSERT(batch_stats.removed_postings == loop_stats.removed_postings);
+}
+
+// Only documents with the same word set as a smaller id may go, whatever the word order, repeats or
+// stop words; different sets must all survive, even when every fingerprint collides
+void TestRemoveDuplicates() {
+    const std::vector <std::string> texts = {
+        "funny pet and nasty rat"s,               // 1 kept
+        "funny pet with curly hair"s,             // 2 kept
+        "funny pet with curly hair"s,             // 3 same text as 2
+        "funny pet and curly hair"s,              // 4 same set as 2, other stop word
+        "funny funny pet and nasty nasty rat"s,   // 5 repeats of 1
+        "funny pet and not very nasty rat"s,      // 6 kept
+        "very nasty rat and not very funny pet"s, // 7 reordered 6
+        "pet with rat and rat and rat"s,          // 8 kept
+        "nasty rat with curly hair"s,             // 9 kept
+        "rat nasty pet funny"s,                   // 10 reordered 1
+        "funny pet nasty"s,                       // 11 kept, a subset of 1
+        "funny pet nasty rat curly"s,             // 12 kept, a superset of 1
+    };
+
+    auto make_server = [&texts] {
+        SearchServer search_server("and with"s);
+
+        // added out of id order, so neither insertion order nor hash order can pick the survivor
+        for (size_t index = texts.size(); index > 0; --index) {
+            search_server.AddDocument(static_cast <int> (index), texts[index - 1], DocumentStatus::ACTUAL, {1});
+        }
+
+        return search_server;
+    };
+
+    const std::vector <int> expected_removed = {3, 4, 5, 7, 10};
+    const std::vector <int> expected_kept = {1, 2, 6, 8, 9, 11, 12};
+
+    const WordSetFingerprint fingerprints[] = {
+        ComputeWordSetFingerprint,
+        // every set collides: only the exact check tells them apart
+        [](const std::vector <std::string_view>&) -> uint64_t { return 42; },
+        // a few buckets, each holding several different sets
+        [](const std::vector <std::string_view>& words) -> uint64_t { return words.size() % 2; },
+    };
+
+    for (const WordSetFingerprint fingerprint : fingerprints) {
+        SearchServer search_server = make_server();
+
+        ASSERT(RemoveDuplicates(search_server, fingerprint) == expected_removed);
+        ASSERT(std::vector <int> (search_server.begin(), search_server.end()) == expected_kept);
+        ASSERT(search_server.GetDocumentCount() == static_cast <int> (expected_kept.size()));
+        ASSERT(search_server.FindTopDocuments("curly"s, {100}).size() == 3);
+        ASSERT(RemoveDuplicates(search_server, fingerprint).empty());
+    }
+
+    SearchServer empty_server("and"s);
+    ASSERT(RemoveDuplicates(empty_server).empty());
+}
+
+void TestSearchServer() {
+    TestRelevanceMatchesIdfFormula();
+    TestResultCountAndTieBreak();
+    TestTokenizerMatchesReference();
+    TestScratchArena();
+    TestTermDictionary();
+    TestPostingList();
+    TestPostingListBlockBoundaries();
+    TestDocumentTable();
+    TestCompactKeepsResults();
+    TestMatchDocumentPolicies();
+    TestPruningMatchesExhaustive();
+    TestStatusFilterMatchesPredicate();
+    TestDocumentLoader();
+    TestRequestQueueAsync();
+    TestShardedSearchServer();
+    TestConcurrentSearchServerStress();
+    TestMetricsRegistry();
+    TestSearchCursor();
+    TestPreparedQuery();
+    TestProcessQueries();
+    TestRequestQueueCache();
+    TestSnapshot();
+    TestAddDocumentsMatchesLoop();
+    TestRemoveDuplicates();
+}
+
 void text_example() {
     std::string stop_words = "and with"s;
     std::vector <std::string> doc_lines = {
@@ -24,7 +1861,9 @@ void text_example() {
 
     std::cout << "Before duplicates removed: "s << search_server.GetDocumentCount() << std::endl;
 
-    RemoveDuplicates(search_server);
+    for (const int document_id : RemoveDuplicates(search_server)) {
+        std::cout << "Found duplicate document id "s << document_id << '\n';
+    }
 
     std::cout << "After duplicates removed: "s << search_server.GetDocumentCount() << std::endl;
 }
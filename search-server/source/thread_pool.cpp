@@ -0,0 +1,130 @@
+#include "../header/thread_pool.h"
+
+#include <algorithm>
+
+namespace {
+    // the pool and the worker the calling thread belongs to, if any
+    thread_local const ThreadPool* current_pool = nullptr;
+    thread_local size_t current_worker = 0;
+}
+
+ThreadPool::ThreadPool(size_t thread_count, size_t queue_capacity)
+    : queue_capacity_(std::max <size_t> (queue_capacity, 1))
+{
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (size_t index = 0; index < thread_count; ++index) {
+        workers_.push_back(std::make_unique <Worker> ());
+    }
+
+    for (size_t index = 0; index < thread_count; ++index) {
+        threads_.emplace_back([this, index]() {
+            Run(index);
+        });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard <std::mutex> guard(sleep_mutex_);
+        is_stopping_ = true;
+    }
+
+    wake_.notify_all();
+
+    for (std::thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+// The slot is counted before the task is pushed, so the capacity holds under concurrent submits
+bool ThreadPool::TrySubmit(Task task) {
+    if (pending_count_.fetch_add(1) >= queue_capacity_) {
+        pending_count_.fetch_sub(1);
+        return false;
+    }
+
+    const size_t worker_index = current_pool == this ? current_worker : next_worker_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+
+    {
+        std::lock_guard <std::mutex> guard(workers_[worker_index]->mutex);
+        workers_[worker_index]->tasks.push_back(std::move(task));
+        queued_count_.fetch_add(1);
+    }
+
+    // taken so a worker between its check and its wait cannot miss the notification
+    {
+        std::lock_guard <std::mutex> guard(sleep_mutex_);
+    }
+
+    wake_.notify_one();
+
+    return true;
+}
+
+size_t ThreadPool::GetThreadCount() const {
+    return threads_.size();
+}
+
+size_t ThreadPool::GetQueueCapacity() const {
+    return queue_capacity_;
+}
+
+size_t ThreadPool::GetPendingCount() const {
+    return pending_count_.load();
+}
+
+// Sleeps on the tasks actually in the deques, so a slot counted by a submit still pushing, or by
+// one turned away, does not keep the worker spinning
+void ThreadPool::Run(size_t worker_index) {
+    current_pool = this;
+    current_worker = worker_index;
+
+    Task task;
+
+    for (;;) {
+        if (TryTake(worker_index, task)) {
+            pending_count_.fetch_sub(1);
+            task();
+            task = nullptr;
+            continue;
+        }
+
+        std::unique_lock <std::mutex> lock(sleep_mutex_);
+        wake_.wait(lock, [this]() {
+            return is_stopping_ || queued_count_.load() > 0;
+        });
+
+        if (is_stopping_ && queued_count_.load() == 0) {
+            return;
+        }
+    }
+}
+
+// Own deque from the back, then the others from the front
+bool ThreadPool::TryTake(size_t worker_index, Task& task) {
+    for (size_t offset = 0; offset < workers_.size(); ++offset) {
+        Worker& worker = *workers_[(worker_index + offset) % workers_.size()];
+        std::lock_guard <std::mutex> guard(worker.mutex);
+
+        if (worker.tasks.empty()) {
+            continue;
+        }
+
+        if (offset == 0) {
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+        } else {
+            task = std::move(worker.tasks.front());
+            worker.tasks.pop_front();
+        }
+
+        queued_count_.fetch_sub(1);
+
+        return true;
+    }
+
+    return false;
+}